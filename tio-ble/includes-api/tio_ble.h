@@ -16,20 +16,133 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
 #include "arm_math.h"
+#include "tio_core.h"
 
+// Notifications wait in per-characteristic queues until the previous one
+// completed. Signal slots queue up to TIO_BLE_SIG_QUEUE_DEPTH notifications,
+// metric slots keep only the latest message, which may be fragmented into up
+// to TIO_BLE_MET_QUEUE_DEPTH notifications (larger metric messages are refused).
+#ifndef TIO_BLE_SIG_QUEUE_DEPTH
+#define TIO_BLE_SIG_QUEUE_DEPTH 4
+#endif
+#ifndef TIO_BLE_MET_QUEUE_DEPTH
+#define TIO_BLE_MET_QUEUE_DEPTH 4 // Notifications in latest message (limits metric fragments)
+#endif
+
+// WSF buffer pool storage is reserved at build time for the largest pool
+// configuration: every slot characteristic notifying at TIO_BLE_POOL_MTU
+// with TIO_BLE_POOL_DEPTH notifications each.
+#ifndef TIO_BLE_POOL_MTU
+#define TIO_BLE_POOL_MTU 247
+#endif
+#ifndef TIO_BLE_POOL_DEPTH
+#define TIO_BLE_POOL_DEPTH 1 // One per characteristic w/ notification credits
+#endif
+
+// WSF buffer pool sizing, fields left 0 take the build time value
+typedef struct {
+    uint8_t slots;       // Slots in use w/ signal + metric each (0 - as TIO_SLOT_TABLE exposes)
+    uint16_t mtu;        // Largest ATT MTU a notification buffer must hold (caps the MTU used)
+    uint8_t queue_depth; // Notifications per characteristic held by the stack
+} tio_ble_pool_config_t;
+
+// WSF buffer pool usage, pool 0 holds the smallest buffers
+typedef struct {
+    uint16_t buf_size;
+    uint8_t num_buf;
+    uint8_t num_alloc;     // Buffers allocated now
+    uint8_t max_alloc;     // High-water mark (needs WSF_BUF_STATS)
+    uint16_t max_req_len;  // Largest request served (needs WSF_BUF_STATS)
+    uint32_t alloc_failed; // Requests this pool's size class couldn't serve
+} tio_ble_pool_stats_t;
+
+typedef enum {
+    TIO_BLE_PROFILE_DEFAULT = 0, // Keep what the central offers
+    TIO_BLE_PROFILE_THROUGHPUT,  // Max MTU (up to pool.mtu), data length extension, 2M PHY, 7.5-15 ms interval
+    TIO_BLE_PROFILE_LOW_POWER,   // 1M PHY, 400-500 ms interval w/ peripheral latency
+} tio_ble_profile_e;
+
+// Stream mode replaces the 8 slot characteristics with one stream
+// characteristic. Each notification carries records of
+// [HDR(1), LENGTH(1), PAYLOAD(LENGTH)], HDR = slot | type << 4 | flags.
+// Fragment records start w/ [msg id, index, count], codec records hold one
+// encoded block. Records wait up to stream_deadline_ms for a full notification.
+// W/ a tick_us_cb each send starts w/ a time record (type 3, slot 0) holding
+// the tick_us_cb value (4 bytes little endian), which applies to the records
+// after it. Signal records of slots under rate control (see TIO_RATE_* in
+// tio_core.h) are sent as type 2 while decimated, their payload starting w/
+// the decimation factor (1 byte).
+#define TIO_BLE_REC_TYPE_SHIFT 4
+#define TIO_BLE_REC_SLOT_MASK 0x0F
+#define TIO_BLE_REC_TYPE_MASK 0x30
+#define TIO_BLE_REC_TYPE_RATE 2
+#define TIO_BLE_REC_TYPE_TIME 3
+#define TIO_BLE_REC_FLAG_CODEC 0x40
+#define TIO_BLE_REC_FLAG_FRAG 0x80
+
+#define TIO_BLE_PHY_1M 1
+#define TIO_BLE_PHY_2M 2
+#define TIO_BLE_PHY_CODED 3
 
-typedef void (*pfnSlotUpdate)(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length);
-typedef void (*pfnUioUpdate)(const uint8_t *data, uint32_t length);
+// Negotiated link parameters
+typedef struct {
+    bool connected;
+    bool negotiating;       // Profile requests still outstanding
+    uint16_t mtu;           // ATT MTU (slot payload per notification is MTU - 5, capped by pool.mtu, max 240)
+    uint16_t tx_octets;     // LL TX payload (data length extension)
+    uint8_t phy;            // TX PHY (TIO_BLE_PHY_*)
+    uint16_t conn_interval; // 1.25 ms units
+    uint16_t conn_latency;  // Connection events
+    uint16_t sup_timeout;   // 10 ms units
+} tio_ble_link_t;
 
 typedef struct {
     pfnUioUpdate uio_update_cb;
     pfnSlotUpdate slot_update_cb;
+    uint8_t codec[TIO_SLOTS]; // Signal slot codec (TIO_CODEC_*), data is then int16 samples
+    tio_ble_profile_e profile; // Link profile requested on connect
+    bool stream;               // Multiplex slots on the stream characteristic
+    uint32_t stream_deadline_ms; // Max record wait in stream mode (0 - flush every send)
+    tio_ble_pool_config_t pool;  // WSF buffer pool sizing
+    pfnTickUs tick_us_cb;        // Optional, timestamps slot data w/ microsecond ticks
 } tio_ble_context_t;
 
+// Link counters, free-running since tio_ble_init()
+typedef struct {
+    uint32_t tx_frames;    // Notifications queued to the stack
+    uint32_t tx_bytes;     // Characteristic value bytes in those notifications
+    uint32_t tx_errors;    // Notifications the stack refused (retried)
+    uint32_t tx_dropped;   // Messages refused for lack of queue space
+    uint32_t tx_coalesced; // Unsent metric notifications replaced by a newer value
+    uint32_t rx_frames;    // Characteristic writes from the client
+    uint32_t wakeups;                 // BLE task wake-ups requested by tio_ble_wake()
+    uint32_t dispatch_latency_max_ms; // Longest wake-up request to dispatch
+    uint32_t dispatch_latency_sum_ms; // Total over wakeups (mean = sum / wakeups)
+} tio_ble_stats_t;
+
 uint32_t tio_ble_init(tio_ble_context_t *ctx);
-void tio_ble_send_slot_data(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length);
-void tio_ble_send_uio_state(const uint8_t *data, uint32_t length);
+// Send APIs are safe from any task (not from ISRs): messages are queued whole
+// under a mutex, then TioBleTask is woken, which owns the WSF stack and blocks
+// until woken or a timer is due. Queues are dropped on disconnect.
+// Data over the notification payload (240 bytes w/ max MTU) is sent as fragments (LENGTH | 0x8000, then [msg id, index, count]).
+// Signal slots w/ a codec send one or more encoded blocks instead (LENGTH | 0x4000).
+// W/ a tick_us_cb every notification of a message carries the tick_us_cb value
+// when it was queued, 4 bytes little endian after LENGTH (LENGTH | 0x2000,
+// payload 4 bytes shorter). Signal slots under rate control carry the
+// decimation factor in LENGTH bits 8-11 while decimated (0 - full rate).
+uint32_t tio_ble_send_slot_data(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length);
+uint32_t tio_ble_slot_space(uint8_t slot, uint8_t slot_type);
+uint32_t tio_ble_set_profile(tio_ble_profile_e profile);
+void tio_ble_get_link(tio_ble_link_t *link);
+uint32_t tio_ble_send_uio_state(const uint8_t *data, uint32_t length);
+void tio_ble_get_stats(tio_ble_stats_t *stats);
+uint32_t tio_ble_get_pool_stats(tio_ble_pool_stats_t *stats, uint32_t maxPools);
+void tio_ble_wake(void); // Task or ISR context
+
+// Transport for tio_core.h fan-out (after tio_ble_init())
+extern const tio_transport_t tioBleTransport;
 
 void
 TioBleTask(void *pvParameters);
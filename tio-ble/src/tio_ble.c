@@ -13,25 +13,37 @@
 #include "ns_ambiqsuite_harness.h"
 #include "FreeRTOS.h"
 #include "task.h"
+#include "semphr.h"
 #include "arm_math.h"
 #include "ns_ble.h"
+#include "dm_api.h"
+#include "att_api.h"
+#include "wsf_os.h"
+#include "wsf_timer.h"
 
-#include "tio_ble.h"
+#include "tio_ble_priv.h"
+#include "tio_codec.h"
 
-#define TIO_BLE_SLOT_SIG_BUF_LEN (242)
-#define TIO_BLE_SLOT_MET_BUF_LEN (242)
 #define TIO_BLE_UIO_BUF_LEN (8)
+#define TIO_BLE_FRAG_FLAG (0x8000)
+#define TIO_BLE_CODEC_FLAG (0x4000)
+#define TIO_BLE_TS_FLAG (0x2000)
+#define TIO_BLE_RATE_SHIFT (8)
+#define TIO_BLE_TS_LEN (4)
+#define TIO_BLE_FRAG_HDR_LEN (3)
 
 #define TIO_SLOT_SVC_UUID "eecb7db88b2d402cb995825538b49328"
-#define TIO_SLOT0_SIG_CHAR_UUID "5bca2754ac7e4a27a1270f328791057a"
-#define TIO_SLOT1_SIG_CHAR_UUID "45415793a0e94740bca4ce90bd61839f"
-#define TIO_SLOT2_SIG_CHAR_UUID "dd19792c63f1420f920cc58bada8efb9"
-#define TIO_SLOT3_SIG_CHAR_UUID "f1f691580bd64cab90a8528baf74cc74"
-
-#define TIO_SLOT0_MET_CHAR_UUID "44a3a7b8d7c849329a10d99dd63775ae"
-#define TIO_SLOT1_MET_CHAR_UUID "e64fa683462848c5bede824aaa7c3f5b"
-#define TIO_SLOT2_MET_CHAR_UUID "b9d28f5365f04392afbcc602f9dc3c8b"
-#define TIO_SLOT3_MET_CHAR_UUID "917c9eb43dbc4cb3bba2ec4e288083f4"
+// Slots 0-3 keep their original characteristic UUIDs, later slots derive
+// theirs from TIO_SLOT_CHAR_UUID_BASE w/ [slot, type] as the last 2 bytes
+static const char *const bleLegacySlotUuids[4][2] = {
+    {"5bca2754ac7e4a27a1270f328791057a", "44a3a7b8d7c849329a10d99dd63775ae"},
+    {"45415793a0e94740bca4ce90bd61839f", "e64fa683462848c5bede824aaa7c3f5b"},
+    {"dd19792c63f1420f920cc58bada8efb9", "b9d28f5365f04392afbcc602f9dc3c8b"},
+    {"f1f691580bd64cab90a8528baf74cc74", "917c9eb43dbc4cb3bba2ec4e288083f4"}};
+#define TIO_SLOT_CHAR_UUID_BASE "a6f1d2c0b8e34f5c9e7d4b2a1c0e"
+#define TIO_BLE_UUID_STR_LEN (33)
+
+#define TIO_STREAM_CHAR_UUID "c4a1f0de3b6e4f2a9d5c7b8e1f2a3b4c"
 
 #define TIO_UIO_CHAR_UUID "b9488d48069b47f794f0387f7fbfd1fa"
 
@@ -40,122 +52,150 @@ typedef struct
     ns_ble_pool_config_t *pool;
     ns_ble_service_t *service;
 
-    ns_ble_characteristic_t *slot0SigChar;
-    ns_ble_characteristic_t *slot1SigChar;
-    ns_ble_characteristic_t *slot2SigChar;
-    ns_ble_characteristic_t *slot3SigChar;
-
-    ns_ble_characteristic_t *slot0MetChar;
-    ns_ble_characteristic_t *slot1MetChar;
-    ns_ble_characteristic_t *slot2MetChar;
-    ns_ble_characteristic_t *slot3MetChar;
-
+    ns_ble_characteristic_t *slotChars; // TIO_BLE_SLOT_CHARS, see tio_ble_tx_init()
+    ns_ble_characteristic_t *streamChar;
     ns_ble_characteristic_t *uioChar;
 
-    void *slot0SigBuffer;
-    void *slot1SigBuffer;
-    void *slot2SigBuffer;
-    void *slot3SigBuffer;
-
-    void *slot0MetBuffer;
-    void *slot1MetBuffer;
-    void *slot2MetBuffer;
-    void *slot3MetBuffer;
-
+    uint8_t (*slotBuffers)[TIO_BLE_SLOT_BUF_LEN];
+    void *streamBuffer;
     uint8_t *uioBuffer;
 
 } tio_ble_lcl_context_t;
 
 
-// WSF buffer pools are a bit of black magic. More development needed.
-#define WEBBLE_WSF_BUFFER_POOLS 4
-#define WEBBLE_WSF_BUFFER_SIZE \
-    (WEBBLE_WSF_BUFFER_POOLS * 16 + 16 * 8 + 32 * 4 + 64 * 6 + 280 * 14) / sizeof(uint32_t)
-
-static uint32_t webbleWSFBufferPool[WEBBLE_WSF_BUFFER_SIZE];
-static wsfBufPoolDesc_t webbleBufferDescriptors[WEBBLE_WSF_BUFFER_POOLS] = {
-    {16, 8}, // 16 bytes, 8 buffers
-    {32, 4},
-    {64, 6},
-    {512, 14}}; // 512
+// WSF buffer pools, descriptors are derived from tio_ble_context_t.pool
+// in tio_ble_init() (see tio_ble_pool_size())
+static uint32_t webbleWSFBufferPool[(TIO_BLE_POOL_MAX_BYTES + sizeof(uint32_t) - 1) / sizeof(uint32_t)];
+static wsfBufPoolDesc_t webbleBufferDescriptors[TIO_BLE_POOLS];
 
 static ns_ble_pool_config_t bleWsfBuffers = {
     .pool = webbleWSFBufferPool,
     .poolSize = sizeof(webbleWSFBufferPool),
     .desc = webbleBufferDescriptors,
-    .descNum = WEBBLE_WSF_BUFFER_POOLS};
-
-static uint8_t bleSlot0SigBuffer[TIO_BLE_SLOT_SIG_BUF_LEN] = {0};
-static uint8_t bleSlot1SigBuffer[TIO_BLE_SLOT_SIG_BUF_LEN] = {0};
-static uint8_t bleSlot2SigBuffer[TIO_BLE_SLOT_SIG_BUF_LEN] = {0};
-static uint8_t bleSlot3SigBuffer[TIO_BLE_SLOT_SIG_BUF_LEN] = {0};
-static uint8_t *bleSlotBuffers[4] = {
-    bleSlot0SigBuffer,
-    bleSlot1SigBuffer,
-    bleSlot2SigBuffer,
-    bleSlot3SigBuffer};
-static uint8_t bleSlot0MetBuffer[TIO_BLE_SLOT_MET_BUF_LEN] = {0};
-static uint8_t bleSlot1MetBuffer[TIO_BLE_SLOT_MET_BUF_LEN] = {0};
-static uint8_t bleSlot2MetBuffer[TIO_BLE_SLOT_MET_BUF_LEN] = {0};
-static uint8_t bleSlot3MetBuffer[TIO_BLE_SLOT_MET_BUF_LEN] = {0};
-static uint8_t *bleSlotMetBuffers[4] = {
-    bleSlot0MetBuffer,
-    bleSlot1MetBuffer,
-    bleSlot2MetBuffer,
-    bleSlot3MetBuffer};
+    .descNum = TIO_BLE_POOLS};
+
+static uint8_t bleSlotBuffers[TIO_BLE_SLOT_CHARS][TIO_BLE_SLOT_BUF_LEN] = {0};
+static uint8_t bleStreamBuffer[TIO_BLE_SLOT_BUF_LEN] = {0};
 static uint8_t bleUioBuffer[TIO_BLE_UIO_BUF_LEN] = {0};
+static uint8_t bleSlotMsgId = 0;
+// Held from tio_ble_tx_begin() to the last post of a slot message
+static SemaphoreHandle_t bleSendMutex = NULL;
 
 static ns_ble_service_t bleService;
-static ns_ble_characteristic_t bleSlot0SigChar;
-static ns_ble_characteristic_t bleSlot1SigChar;
-static ns_ble_characteristic_t bleSlot2SigChar;
-static ns_ble_characteristic_t bleSlot3SigChar;
-static ns_ble_characteristic_t bleSlot0MetChar;
-static ns_ble_characteristic_t bleSlot1MetChar;
-static ns_ble_characteristic_t bleSlot2MetChar;
-static ns_ble_characteristic_t bleSlot3MetChar;
-static ns_ble_characteristic_t *bleSlotSigChars[4] = {
-    &bleSlot0SigChar,
-    &bleSlot1SigChar,
-    &bleSlot2SigChar,
-    &bleSlot3SigChar};
-static ns_ble_characteristic_t *bleSlotMetChars[4] = {
-    &bleSlot0MetChar,
-    &bleSlot1MetChar,
-    &bleSlot2MetChar,
-    &bleSlot3MetChar};
-
+static ns_ble_characteristic_t bleSlotChars[TIO_BLE_SLOT_CHARS];
+static char bleSlotUuids[TIO_BLE_SLOT_CHARS][TIO_BLE_UUID_STR_LEN];
+static ns_ble_characteristic_t bleStreamChar;
 static ns_ble_characteristic_t bleUioChar;
 
 static tio_ble_lcl_context_t tioBleCtx = {
     .pool = &bleWsfBuffers,
     .service = &bleService,
-    .slot0SigChar = &bleSlot0SigChar,
-    .slot1SigChar = &bleSlot1SigChar,
-    .slot2SigChar = &bleSlot2SigChar,
-    .slot3SigChar = &bleSlot3SigChar,
-    .slot0MetChar = &bleSlot0MetChar,
-    .slot1MetChar = &bleSlot1MetChar,
-    .slot2MetChar = &bleSlot2MetChar,
-    .slot3MetChar = &bleSlot3MetChar,
+    .slotChars = bleSlotChars,
+    .streamChar = &bleStreamChar,
     .uioChar = &bleUioChar,
-    .slot0SigBuffer = bleSlot0SigBuffer,
-    .slot1SigBuffer = bleSlot1SigBuffer,
-    .slot2SigBuffer = bleSlot2SigBuffer,
-    .slot3SigBuffer = bleSlot3SigBuffer,
-    .slot0MetBuffer = bleSlot0MetBuffer,
-    .slot1MetBuffer = bleSlot1MetBuffer,
-    .slot2MetBuffer = bleSlot2MetBuffer,
-    .slot3MetBuffer = bleSlot3MetBuffer,
+    .slotBuffers = bleSlotBuffers,
+    .streamBuffer = bleStreamBuffer,
     .uioBuffer = bleUioBuffer
 };
 
 static tio_ble_context_t *gTioBleCtx = NULL;
 
+static dmConnId_t bleConnId = DM_CONN_ID_NONE;
+
+static TaskHandle_t bleTaskHandle = NULL;
+static volatile bool bleWakePending = false;
+static volatile uint32_t bleWakeStart = 0;
+static volatile bool bleUioPending = false;
+
+static uint32_t
+tio_ble_now_ms(void)
+{
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+static uint32_t
+tio_ble_request_mtu(uint16_t mtu)
+{
+    AttcMtuReq(bleConnId, mtu);
+    return 0;
+}
+
+static uint32_t
+tio_ble_request_data_len(uint16_t txOctets, uint16_t txTime)
+{
+    DmConnSetDataLen(bleConnId, txOctets, txTime);
+    return 0;
+}
+
+static uint32_t
+tio_ble_request_phy(uint8_t phy)
+{
+    uint8_t phyBit = phy == TIO_BLE_PHY_2M ? HCI_PHY_LE_2M_BIT : phy == TIO_BLE_PHY_CODED ? HCI_PHY_LE_CODED_BIT : HCI_PHY_LE_1M_BIT;
+    DmSetPhy(bleConnId, HCI_ALL_PHY_ALL_PREFERENCES, phyBit, phyBit, HCI_PHY_OPTIONS_NONE);
+    return 0;
+}
+
+static uint32_t
+tio_ble_request_conn_params(uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t timeout)
+{
+    hciConnSpec_t connSpec = {
+        .connIntervalMin = minInterval,
+        .connIntervalMax = maxInterval,
+        .connLatency = latency,
+        .supTimeout = timeout,
+        .minCeLen = 0,
+        .maxCeLen = 0xFFFF};
+    DmConnUpdate(bleConnId, &connSpec);
+    return 0;
+}
+
+static const tio_ble_link_ops_t bleLinkOps = {
+    .now_ms = tio_ble_now_ms,
+    .request_mtu = tio_ble_request_mtu,
+    .request_data_len = tio_ble_request_data_len,
+    .request_phy = tio_ble_request_phy,
+    .request_conn_params = tio_ble_request_conn_params,
+};
+
 void
 webbleHandler(wsfEventMask_t event, wsfMsgHdr_t *pMsg)
 {
-    ns_lp_printf("webbleHandler\n");
+    if (pMsg == NULL)
+    {
+        return;
+    }
+    dmEvt_t *dmEvt = (dmEvt_t *)pMsg;
+    switch (pMsg->event)
+    {
+    case DM_CONN_OPEN_IND:
+        bleConnId = (dmConnId_t)pMsg->param;
+        tio_ble_link_on_open(dmEvt->connOpen.connInterval, dmEvt->connOpen.connLatency, dmEvt->connOpen.supTimeout);
+        break;
+    case DM_CONN_CLOSE_IND:
+        bleConnId = DM_CONN_ID_NONE;
+        tio_ble_link_on_close();
+        // Credits of notifications the stack held never come back
+        xSemaphoreTake(bleSendMutex, portMAX_DELAY);
+        tio_ble_stream_reset();
+        tio_ble_tx_reset();
+        xSemaphoreGive(bleSendMutex);
+        break;
+    case DM_CONN_UPDATE_IND:
+        tio_ble_link_on_conn_params(dmEvt->connUpdate.status, dmEvt->connUpdate.connInterval,
+                                    dmEvt->connUpdate.connLatency, dmEvt->connUpdate.supTimeout);
+        break;
+    case DM_PHY_UPDATE_IND:
+        tio_ble_link_on_phy(dmEvt->phyUpdate.status, dmEvt->phyUpdate.txPhy);
+        break;
+    case DM_CONN_DATA_LEN_CHANGE_IND:
+        tio_ble_link_on_data_len(dmEvt->dataLenChange.maxTxOctets);
+        break;
+    case ATT_MTU_UPDATE_IND:
+        tio_ble_link_on_mtu(((attEvt_t *)pMsg)->mtu);
+        break;
+    default:
+        break;
+    }
 }
 void
 webbleHandlerInit(wsfHandlerId_t handlerId)
@@ -164,14 +204,16 @@ webbleHandlerInit(wsfHandlerId_t handlerId)
 }
 
 int
-tio_ble_notify_sig_handler(ns_ble_service_t *s, struct ns_ble_characteristic *c)
+tio_ble_notify_slot_handler(ns_ble_service_t *s, struct ns_ble_characteristic *c)
 {
+    tio_ble_tx_credit(c);
     return NS_STATUS_SUCCESS;
 }
 
 int
-tio_ble_notify_met_handler(ns_ble_service_t *s, struct ns_ble_characteristic *c)
+tio_ble_notify_stream_handler(ns_ble_service_t *s, struct ns_ble_characteristic *c)
 {
+    tio_ble_tx_credit(c);
     return NS_STATUS_SUCCESS;
 }
 
@@ -192,6 +234,7 @@ int
 tio_ble_uio_write_handler(ns_ble_service_t *s, struct ns_ble_characteristic *c, void *src)
 {
     memcpy(c->applicationValue, src, c->valueLen);
+    tioBleStats.rx_frames++;
     if (c == tioBleCtx.uioChar)
     {
         if (gTioBleCtx->uio_update_cb != NULL)
@@ -202,53 +245,395 @@ tio_ble_uio_write_handler(ns_ble_service_t *s, struct ns_ble_characteristic *c,
     return NS_STATUS_SUCCESS;
 }
 
-void
-tio_ble_send_slot_data(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length)
+/**
+ * @brief Get slot notification payload, less the timestamp if enabled
+ */
+static inline uint32_t
+tio_ble_slot_payload_len(void)
 {
-    uint8_t *buffer = NULL;
-    ns_ble_characteristic_t *bleChar = NULL;
-    if (length > 240)
+    return tio_ble_link_payload_len() - (gTioBleCtx->tick_us_cb ? TIO_BLE_TS_LEN : 0);
+}
+
+/**
+ * @brief Take the timestamp for a message's notifications
+ */
+static inline uint32_t
+tio_ble_stamp(void)
+{
+    return gTioBleCtx->tick_us_cb ? gTioBleCtx->tick_us_cb() : 0;
+}
+
+/**
+ * @brief Write LENGTH (w/ flags and decimation factor) and the timestamp if enabled
+ *
+ * @param value Notification value
+ * @param dlen Payload length | flags
+ * @param rate Decimation factor (1 - full rate)
+ * @param now Timestamp
+ * @return uint32_t Bytes ahead of the payload
+ */
+static uint32_t
+tio_ble_value_hdr(uint8_t *value, uint16_t dlen, uint8_t rate, uint32_t now)
+{
+    if (rate > 1)
     {
-        ns_lp_printf("Data length exceeds 240 bytes\n");
-        return;
+        dlen |= rate << TIO_BLE_RATE_SHIFT;
     }
-    if (slot >= 4)
+    if (gTioBleCtx->tick_us_cb == NULL)
     {
-        ns_lp_printf("Invalid slot number\n");
-        return;
+        value[0] = dlen & 0xFF;
+        value[1] = (dlen >> 8) & 0xFF;
+        return 2;
+    }
+    dlen |= TIO_BLE_TS_FLAG;
+    value[0] = dlen & 0xFF;
+    value[1] = (dlen >> 8) & 0xFF;
+    value[2] = now & 0xFF;
+    value[3] = (now >> 8) & 0xFF;
+    value[4] = (now >> 16) & 0xFF;
+    value[5] = (now >> 24) & 0xFF;
+    return 2 + TIO_BLE_TS_LEN;
+}
+
+/**
+ * @brief Queue samples as encoded blocks, one per notification
+ *
+ * @param slot Slot number
+ * @param codec Codec ID
+ * @param samples Samples
+ * @param count Number of samples
+ * @return uint32_t
+ */
+static uint32_t
+tio_ble_send_slot_encoded(uint8_t slot, uint8_t codec, const int16_t *samples, uint32_t count)
+{
+    uint8_t value[TIO_BLE_SLOT_BUF_LEN];
+    uint32_t payloadLen = tio_ble_slot_payload_len();
+    uint32_t hdrLen = gTioBleCtx->tick_us_cb ? 2 + TIO_BLE_TS_LEN : 2;
+    uint32_t now = tio_ble_stamp();
+    uint32_t blocks = tio_codec_max_blocks(codec, count, payloadLen);
+    if (count && blocks == 0)
+    {
+        ns_lp_printf("Invalid slot codec\n");
+        return 1;
     }
-    if (slot_type >= 2)
+    // All or nothing, the client can't use part of the samples
+    xSemaphoreTake(bleSendMutex, portMAX_DELAY);
+    if (tio_ble_tx_begin(slot, 0, blocks))
     {
-        ns_lp_printf("Invalid slot type\n");
-        return;
+        xSemaphoreGive(bleSendMutex);
+        return 1;
+    }
+    while (count)
+    {
+        uint32_t encoded;
+        uint16_t dlen = tio_codec_encode(codec, samples, count, value + hdrLen, payloadLen, &encoded);
+        tio_ble_value_hdr(value, dlen | TIO_BLE_CODEC_FLAG, 1, now);
+        tio_ble_tx_post(slot, 0, value, dlen + hdrLen);
+        samples += encoded;
+        count -= encoded;
+    }
+    xSemaphoreGive(bleSendMutex);
+    tio_ble_wake();
+    return 0;
+}
+
+/**
+ * @brief Queue blocks encoded by the core, one per notification
+ *
+ * @param slot Slot number
+ * @param blocks Encoded blocks back to back
+ * @param blockLens Block lengths
+ * @param numBlocks Number of blocks
+ * @param rate Decimation factor of the samples
+ * @return uint32_t
+ */
+static uint32_t
+tio_ble_send_slot_blocks(uint8_t slot, const uint8_t *blocks, const uint16_t *blockLens, uint32_t numBlocks,
+                         uint8_t rate)
+{
+    uint8_t value[TIO_BLE_SLOT_BUF_LEN];
+    uint32_t payloadLen = tio_ble_slot_payload_len();
+    uint32_t now = tio_ble_stamp();
+    for (uint32_t i = 0; i < numBlocks; i++)
+    {
+        // Link may have renegotiated a smaller MTU since the core encoded
+        if (blockLens[i] > payloadLen)
+        {
+            return 1;
+        }
     }
-    if (slot_type == 0)
+    // All blocks or none
+    xSemaphoreTake(bleSendMutex, portMAX_DELAY);
+    if (tio_ble_tx_begin(slot, 0, numBlocks))
     {
-        buffer = bleSlotBuffers[slot];
-        bleChar = bleSlotSigChars[slot];
+        xSemaphoreGive(bleSendMutex);
+        return 1;
     }
-    else
+    for (uint32_t i = 0; i < numBlocks; i++)
     {
-        buffer = bleSlotMetBuffers[slot];
-        bleChar = bleSlotMetChars[slot];
+        uint16_t dlen = blockLens[i];
+        uint32_t hdrLen = tio_ble_value_hdr(value, dlen | TIO_BLE_CODEC_FLAG, rate, now);
+        memcpy(value + hdrLen, blocks, dlen);
+        tio_ble_tx_post(slot, 0, value, dlen + hdrLen);
+        blocks += dlen;
     }
-    buffer[0] = length & 0xFF;
-    buffer[1] = (length >> 8) & 0xFF;
-    memset(buffer + 2, 0, 240);
-    memcpy(buffer + 2, data, length);
-    ns_ble_send_value(bleChar, NULL);
+    xSemaphoreGive(bleSendMutex);
+    tio_ble_wake();
+    return 0;
+}
+
+/**
+ * @brief Queue raw slot data as one notification or fragments
+ */
+static uint32_t
+tio_ble_send_slot_raw(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length, uint8_t rate)
+{
+    uint8_t value[TIO_BLE_SLOT_BUF_LEN];
+    // Notifications are sized to the negotiated MTU
+    uint32_t payloadLen = tio_ble_slot_payload_len();
+    uint32_t fragDataLen = payloadLen - TIO_BLE_FRAG_HDR_LEN;
+    if (gTioBleCtx->stream)
+    {
+        return tio_ble_stream_send(slot, slot_type, TIO_CODEC_NONE, data, length, rate);
+    }
+    uint32_t now = tio_ble_stamp();
+    if (length > fragDataLen * 255)
+    {
+        ns_lp_printf("Data length exceeds limit\n");
+        return 1;
+    }
+    if (length <= payloadLen)
+    {
+        uint32_t hdrLen = tio_ble_value_hdr(value, length, rate, now);
+        memcpy(value + hdrLen, data, length);
+        xSemaphoreTake(bleSendMutex, portMAX_DELAY);
+        if (tio_ble_tx_begin(slot, slot_type, 1))
+        {
+            xSemaphoreGive(bleSendMutex);
+            return 1;
+        }
+        tio_ble_tx_post(slot, slot_type, value, length + hdrLen);
+        xSemaphoreGive(bleSendMutex);
+        tio_ble_wake();
+        return 0;
+    }
+    // Larger messages go out as consecutive notifications, each w/ LENGTH
+    // flagged and a [msg id, index, count] header ahead of the payload
+    uint8_t count = (length + fragDataLen - 1) / fragDataLen;
+    xSemaphoreTake(bleSendMutex, portMAX_DELAY);
+    if (tio_ble_tx_begin(slot, slot_type, count))
+    {
+        xSemaphoreGive(bleSendMutex);
+        return 1;
+    }
+    uint8_t msgId = bleSlotMsgId++;
+    for (uint32_t index = 0; index < count; index++)
+    {
+        uint32_t offset = index * fragDataLen;
+        uint32_t fragLen = length - offset > fragDataLen ? fragDataLen : length - offset;
+        uint32_t hdrLen = tio_ble_value_hdr(value, (fragLen + TIO_BLE_FRAG_HDR_LEN) | TIO_BLE_FRAG_FLAG, rate, now);
+        value[hdrLen] = msgId;
+        value[hdrLen + 1] = index;
+        value[hdrLen + 2] = count;
+        memcpy(value + hdrLen + TIO_BLE_FRAG_HDR_LEN, data + offset, fragLen);
+        tio_ble_tx_post(slot, slot_type, value, fragLen + TIO_BLE_FRAG_HDR_LEN + hdrLen);
+    }
+    xSemaphoreGive(bleSendMutex);
+    tio_ble_wake();
+    return 0;
+}
+
+/**
+ * @brief Queue slot data for notification
+ *
+ * @param slot Slot number (0 - TIO_SLOTS-1)
+ * @param slot_type Slot type (0 - signal, 1 - metric)
+ * @param data Slot data (int16 samples, so an even length, for slots w/ a codec)
+ * @param length Data length
+ * @return uint32_t 0 if queued, 1 if refused (see tio_ble_slot_space())
+ */
+uint32_t
+tio_ble_send_slot_data(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length)
+{
+    if (!tio_slot_valid(slot, slot_type))
+    {
+        ns_lp_printf("Invalid slot\n");
+        return 1;
+    }
+    if (slot_type == 0 && gTioBleCtx->codec[slot] != TIO_CODEC_NONE)
+    {
+        if (length & 1)
+        {
+            ns_lp_printf("Odd sample data length\n");
+            return 1;
+        }
+        if (gTioBleCtx->stream)
+        {
+            return tio_ble_stream_send(slot, slot_type, gTioBleCtx->codec[slot], data, length, 1);
+        }
+        return tio_ble_send_slot_encoded(slot, gTioBleCtx->codec[slot], (const int16_t *)data, length / 2);
+    }
+    return tio_ble_send_slot_raw(slot, slot_type, data, length, 1);
 }
 
 void
+tio_ble_get_stats(tio_ble_stats_t *stats)
+{
+    *stats = tioBleStats;
+}
+
+uint32_t
 tio_ble_send_uio_state(const uint8_t *data, uint32_t length)
 {
     if (length != 8)
     {
         ns_lp_printf("Invalid UIO data length\n");
-        return;
+        return 1;
     }
+    taskENTER_CRITICAL();
     memcpy(tioBleCtx.uioBuffer, data, length);
-    ns_ble_send_value(tioBleCtx.uioChar, NULL);
+    bleUioPending = true;
+    taskEXIT_CRITICAL();
+    tio_ble_wake();
+    return 0;
+}
+
+static uint32_t
+tio_ble_transport_max_payload(void)
+{
+    return gTioBleCtx->stream ? tio_ble_link_payload_len() : tio_ble_slot_payload_len();
+}
+
+static uint32_t
+tio_ble_transport_send(const tio_slot_update_t *update)
+{
+    uint8_t rate = update->rate_div ? update->rate_div : 1;
+    if (update->num_blocks == 0)
+    {
+        return tio_ble_send_slot_raw(update->slot, update->slot_type, update->data, update->length, rate);
+    }
+    if (gTioBleCtx->stream)
+    {
+        return tio_ble_stream_send_blocks(update->slot, update->blocks, update->block_lens, update->num_blocks,
+                                          rate);
+    }
+    return tio_ble_send_slot_blocks(update->slot, update->blocks, update->block_lens, update->num_blocks, rate);
+}
+
+static uint32_t
+tio_ble_transport_backlog(uint8_t slot)
+{
+    tio_ble_link_t link;
+    tio_ble_get_link(&link);
+    if (!link.connected)
+    {
+        return TIO_BACKLOG_IDLE;
+    }
+    return gTioBleCtx->stream ? tio_ble_tx_backlog(0, TIO_BLE_TX_STREAM) : tio_ble_tx_backlog(slot, TIO_SLOT_SIGNAL);
+}
+
+static bool
+tio_ble_transport_rate_tag(void)
+{
+    // Every slot and stream header carries the rate
+    return true;
+}
+
+const tio_transport_t tioBleTransport = {
+    .max_payload = tio_ble_transport_max_payload,
+    .send = tio_ble_transport_send,
+    .send_uio = tio_ble_send_uio_state,
+    .backlog = tio_ble_transport_backlog,
+    .rate_tag = tio_ble_transport_rate_tag,
+};
+
+/**
+ * @brief Wake TioBleTask to dispatch WSF events and send queued notifications
+ */
+void
+tio_ble_wake(void)
+{
+    if (bleTaskHandle == NULL)
+    {
+        return;
+    }
+    if (xPortIsInsideInterrupt())
+    {
+        BaseType_t woken = pdFALSE;
+        if (!bleWakePending)
+        {
+            bleWakeStart = xTaskGetTickCountFromISR() * portTICK_PERIOD_MS;
+            bleWakePending = true;
+        }
+        vTaskNotifyGiveFromISR(bleTaskHandle, &woken);
+        portYIELD_FROM_ISR(woken);
+        return;
+    }
+    taskENTER_CRITICAL();
+    if (!bleWakePending)
+    {
+        bleWakeStart = tio_ble_now_ms();
+        bleWakePending = true;
+    }
+    taskEXIT_CRITICAL();
+    xTaskNotifyGive(bleTaskHandle);
+}
+
+/**
+ * @brief WSF signals new events here (wsfSetEvent(), HCI transport, timers)
+ *
+ * Weak so a port that already routes the OS event elsewhere keeps its own,
+ * it should then call tio_ble_wake().
+ */
+__attribute__((weak)) void
+WsfSetOsSpecificEvent(void)
+{
+    tio_ble_wake();
+}
+
+/**
+ * @brief Get ticks TioBleTask may block before a WSF timer, link step or
+ * stream deadline is due
+ */
+static TickType_t
+tio_ble_wait_ticks(void)
+{
+    bool_t timerRunning;
+    wsfTimerTicks_t wsfTicks = WsfTimerNextExpiration(&timerRunning);
+    uint32_t waitMs = timerRunning ? wsfTicks * WSF_MS_PER_TICK : UINT32_MAX;
+    uint32_t linkMs = tio_ble_link_next_ms();
+    uint32_t streamMs = tio_ble_stream_next_ms();
+    waitMs = linkMs < waitMs ? linkMs : waitMs;
+    waitMs = streamMs < waitMs ? streamMs : waitMs;
+    return waitMs == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(waitMs);
+}
+
+/**
+ * @brief Get the UUID of a slot characteristic
+ *
+ * @param slot Slot number
+ * @param slotType Slot type
+ * @param uuid UUID string buffer (TIO_BLE_UUID_STR_LEN bytes)
+ * @return const char* uuid
+ */
+static const char *
+tio_ble_slot_uuid(uint8_t slot, uint8_t slotType, char *uuid)
+{
+    static const char hex[] = "0123456789abcdef";
+    if (slot < 4)
+    {
+        memcpy(uuid, bleLegacySlotUuids[slot][slotType], TIO_BLE_UUID_STR_LEN);
+        return uuid;
+    }
+    memcpy(uuid, TIO_SLOT_CHAR_UUID_BASE, sizeof(TIO_SLOT_CHAR_UUID_BASE) - 1);
+    char *tail = uuid + sizeof(TIO_SLOT_CHAR_UUID_BASE) - 1;
+    tail[0] = hex[slot >> 4];
+    tail[1] = hex[slot & 0xF];
+    tail[2] = hex[slotType >> 4];
+    tail[3] = hex[slotType & 0xF];
+    tail[4] = '\0';
+    return uuid;
 }
 
 static int
@@ -263,50 +648,45 @@ tio_ble_service_init(void)
     tioBleCtx.service->poolConfig = tioBleCtx.pool;
     tioBleCtx.service->numAttributes = 0;
 
-    // Create all slots
-    ns_ble_create_characteristic(
-        tioBleCtx.slot0SigChar, TIO_SLOT0_SIG_CHAR_UUID, tioBleCtx.slot0SigBuffer, TIO_BLE_SLOT_SIG_BUF_LEN,
-        NS_BLE_READ | NS_BLE_NOTIFY,
-        NULL, NULL, &tio_ble_notify_sig_handler,
-        1000, true, &(tioBleCtx.service->numAttributes));
-    ns_ble_create_characteristic(
-        tioBleCtx.slot0MetChar, TIO_SLOT0_MET_CHAR_UUID, tioBleCtx.slot0MetBuffer, TIO_BLE_SLOT_MET_BUF_LEN,
-        NS_BLE_READ | NS_BLE_NOTIFY,
-        NULL, NULL, &tio_ble_notify_met_handler,
-        1000, true, &(tioBleCtx.service->numAttributes));
-
-    ns_ble_create_characteristic(
-        tioBleCtx.slot1SigChar, TIO_SLOT1_SIG_CHAR_UUID, tioBleCtx.slot1SigBuffer, TIO_BLE_SLOT_SIG_BUF_LEN,
-        NS_BLE_READ | NS_BLE_NOTIFY,
-        NULL, NULL, &tio_ble_notify_sig_handler,
-        1000, true, &(tioBleCtx.service->numAttributes));
-    ns_ble_create_characteristic(
-        tioBleCtx.slot1MetChar, TIO_SLOT1_MET_CHAR_UUID, tioBleCtx.slot1MetBuffer, TIO_BLE_SLOT_MET_BUF_LEN,
-        NS_BLE_READ | NS_BLE_NOTIFY,
-        NULL, NULL, &tio_ble_notify_met_handler,
-        1000, true, &(tioBleCtx.service->numAttributes));
-
-    ns_ble_create_characteristic(
-        tioBleCtx.slot2SigChar, TIO_SLOT2_SIG_CHAR_UUID, tioBleCtx.slot2SigBuffer, TIO_BLE_SLOT_SIG_BUF_LEN,
-        NS_BLE_READ | NS_BLE_NOTIFY,
-        NULL, NULL, &tio_ble_notify_sig_handler,
-        1000, true, &(tioBleCtx.service->numAttributes));
-    ns_ble_create_characteristic(
-        tioBleCtx.slot2MetChar, TIO_SLOT2_MET_CHAR_UUID, tioBleCtx.slot2MetBuffer, TIO_BLE_SLOT_MET_BUF_LEN,
-        NS_BLE_READ | NS_BLE_NOTIFY,
-        NULL, NULL, &tio_ble_notify_met_handler,
-        1000, true, &(tioBleCtx.service->numAttributes));
+    if (gTioBleCtx->stream)
+    {
+        // Stream mode: all slots share one characteristic
+        ns_ble_create_characteristic(
+            tioBleCtx.streamChar, TIO_STREAM_CHAR_UUID, tioBleCtx.streamBuffer, TIO_BLE_SLOT_BUF_LEN,
+            NS_BLE_READ | NS_BLE_NOTIFY,
+            NULL, NULL, &tio_ble_notify_stream_handler,
+            1000, true, &(tioBleCtx.service->numAttributes));
+        ns_ble_create_characteristic(
+            tioBleCtx.uioChar, TIO_UIO_CHAR_UUID, tioBleCtx.uioBuffer, TIO_BLE_UIO_BUF_LEN,
+            NS_BLE_READ | NS_BLE_WRITE | NS_BLE_NOTIFY,
+            &tio_ble_uio_read_handler, &tio_ble_uio_write_handler, &tio_ble_notify_uio_handler,
+            1000, true, &(tioBleCtx.service->numAttributes));
+        tioBleCtx.service->numCharacteristics = 2;
+        ns_ble_create_service(tioBleCtx.service);
+        ns_ble_add_characteristic(tioBleCtx.service, tioBleCtx.streamChar);
+        ns_ble_add_characteristic(tioBleCtx.service, tioBleCtx.uioChar);
+        ns_ble_start_service(tioBleCtx.service);
+        return NS_STATUS_SUCCESS;
+    }
 
-    ns_ble_create_characteristic(
-        tioBleCtx.slot3SigChar, TIO_SLOT3_SIG_CHAR_UUID, tioBleCtx.slot3SigBuffer, TIO_BLE_SLOT_SIG_BUF_LEN,
-        NS_BLE_READ | NS_BLE_NOTIFY,
-        NULL, NULL, &tio_ble_notify_sig_handler,
-        1000, true, &(tioBleCtx.service->numAttributes));
-    ns_ble_create_characteristic(
-        tioBleCtx.slot3MetChar, TIO_SLOT3_MET_CHAR_UUID, tioBleCtx.slot3MetBuffer, TIO_BLE_SLOT_MET_BUF_LEN,
-        NS_BLE_READ | NS_BLE_NOTIFY,
-        NULL, NULL, tio_ble_notify_met_handler,
-        1000, true, &(tioBleCtx.service->numAttributes));
+    // Create a characteristic for every slot type in TIO_SLOT_TABLE
+    for (uint32_t slot = 0; slot < TIO_BLE_SLOTS; slot++)
+    {
+        for (uint32_t type = 0; type < 2; type++)
+        {
+            ns_ble_characteristic_t *c = tio_ble_tx_char(slot, type);
+            if (c == NULL)
+            {
+                continue;
+            }
+            uint32_t idx = c - tioBleCtx.slotChars;
+            ns_ble_create_characteristic(
+                c, tio_ble_slot_uuid(slot, type, bleSlotUuids[idx]), tioBleCtx.slotBuffers[idx], TIO_BLE_SLOT_BUF_LEN,
+                NS_BLE_READ | NS_BLE_NOTIFY,
+                NULL, NULL, &tio_ble_notify_slot_handler,
+                1000, true, &(tioBleCtx.service->numAttributes));
+        }
+    }
 
     // UIO
     ns_ble_create_characteristic(
@@ -315,16 +695,12 @@ tio_ble_service_init(void)
         &tio_ble_uio_read_handler, &tio_ble_uio_write_handler, &tio_ble_notify_uio_handler,
         1000, true, &(tioBleCtx.service->numAttributes));
 
-    tioBleCtx.service->numCharacteristics = 9;
+    tioBleCtx.service->numCharacteristics = TIO_BLE_SLOT_CHARS + 1;
     ns_ble_create_service(tioBleCtx.service);
-    ns_ble_add_characteristic(tioBleCtx.service, tioBleCtx.slot0SigChar);
-    ns_ble_add_characteristic(tioBleCtx.service, tioBleCtx.slot0MetChar);
-    ns_ble_add_characteristic(tioBleCtx.service, tioBleCtx.slot1SigChar);
-    ns_ble_add_characteristic(tioBleCtx.service, tioBleCtx.slot1MetChar);
-    ns_ble_add_characteristic(tioBleCtx.service, tioBleCtx.slot2SigChar);
-    ns_ble_add_characteristic(tioBleCtx.service, tioBleCtx.slot2MetChar);
-    ns_ble_add_characteristic(tioBleCtx.service, tioBleCtx.slot3SigChar);
-    ns_ble_add_characteristic(tioBleCtx.service, tioBleCtx.slot3MetChar);
+    for (uint32_t i = 0; i < TIO_BLE_SLOT_CHARS; i++)
+    {
+        ns_ble_add_characteristic(tioBleCtx.service, &tioBleCtx.slotChars[i]);
+    }
     ns_ble_add_characteristic(tioBleCtx.service, tioBleCtx.uioChar);
     // Initialize BLE, create structs, start service
     ns_ble_start_service(tioBleCtx.service);
@@ -333,10 +709,39 @@ tio_ble_service_init(void)
 
 void TioBleTask(void *pvParameters)
 {
+    bleTaskHandle = xTaskGetCurrentTaskHandle();
     NS_TRY(tio_ble_service_init(), "BLE init failed.\n");
     while (1)
     {
+        WsfTimerSleepUpdate();
         wsfOsDispatcher();
+        tio_ble_link_poll();
+        tio_ble_stream_poll();
+        if (bleUioPending)
+        {
+            bleUioPending = false;
+            tio_ble_notify(tioBleCtx.uioChar, TIO_BLE_UIO_BUF_LEN);
+        }
+        tio_ble_tx_poll();
+        if (!wsfOsReadyToSleep())
+        {
+            continue;
+        }
+        // Block until woken or something is due
+        ulTaskNotifyTake(pdTRUE, tio_ble_wait_ticks());
+        taskENTER_CRITICAL();
+        if (bleWakePending)
+        {
+            uint32_t latency = tio_ble_now_ms() - bleWakeStart;
+            bleWakePending = false;
+            tioBleStats.wakeups++;
+            tioBleStats.dispatch_latency_sum_ms += latency;
+            if (latency > tioBleStats.dispatch_latency_max_ms)
+            {
+                tioBleStats.dispatch_latency_max_ms = latency;
+            }
+        }
+        taskEXIT_CRITICAL();
     }
 }
 
@@ -344,6 +749,31 @@ uint32_t
 tio_ble_init(tio_ble_context_t *ctx)
 {
     gTioBleCtx = ctx;
+    if (bleSendMutex == NULL)
+    {
+        bleSendMutex = xSemaphoreCreateMutex();
+        if (bleSendMutex == NULL)
+        {
+            ns_lp_printf("Failed to create BLE send mutex\n");
+            return 1;
+        }
+    }
+    uint32_t poolSize = tio_ble_pool_size(&ctx->pool, ctx->stream, webbleBufferDescriptors);
+    if (poolSize > sizeof(webbleWSFBufferPool))
+    {
+        ns_lp_printf("WSF pool config exceeds TIO_BLE_POOL_MAX_BYTES\n");
+        return 1;
+    }
+    bleWsfBuffers.poolSize = poolSize;
+    tio_ble_pool_init(webbleBufferDescriptors);
+    memset(&tioBleStats, 0, sizeof(tioBleStats));
+    tio_ble_tx_init(tioBleCtx.slotChars, ctx->stream ? tioBleCtx.streamChar : NULL);
+    tio_ble_link_init(&bleLinkOps, ctx->profile, ctx->pool.mtu ? ctx->pool.mtu : TIO_BLE_POOL_MTU);
+    if (tio_ble_stream_init(ctx->stream_deadline_ms, ctx->tick_us_cb))
+    {
+        ns_lp_printf("Failed to create BLE stream mutex\n");
+        return 1;
+    }
     ns_ble_pre_init();
     return NS_STATUS_SUCCESS;
 }
@@ -0,0 +1,265 @@
+/**
+ * @file tio_ble_link.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio BLE link parameter negotiation
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <string.h>
+#include "tio_ble_priv.h"
+
+// Each profile is negotiated one procedure at a time (MTU, DLE, PHY, then
+// connection parameters). A step completes on its update event or after
+// TIO_BLE_LINK_STEP_TIMEOUT_MS since centrals don't report unchanged values.
+typedef enum {
+    TIO_BLE_LINK_IDLE = 0,
+    TIO_BLE_LINK_MTU,
+    TIO_BLE_LINK_DATA_LEN,
+    TIO_BLE_LINK_PHY,
+    TIO_BLE_LINK_CONN_PARAMS,
+    TIO_BLE_LINK_DONE,
+} tio_ble_link_state_e;
+
+typedef struct {
+    uint16_t mtu;      // 0 - skip
+    uint16_t txOctets; // 0 - skip
+    uint16_t txTime;
+    uint8_t phy;       // 0 - skip
+    uint16_t minInterval;
+    uint16_t maxInterval;
+    uint16_t latency;
+    uint16_t timeout;
+} tio_ble_link_profile_t;
+
+static const tio_ble_link_profile_t bleLinkProfiles[] = {
+    [TIO_BLE_PROFILE_DEFAULT] = {0},
+    // 7.5-15 ms intervals, 251 byte LL payloads on 2M PHY
+    [TIO_BLE_PROFILE_THROUGHPUT] = {TIO_BLE_LINK_MAX_MTU, 251, 2120, TIO_BLE_PHY_2M, 6, 12, 0, 400},
+    // 400-500 ms intervals, peripheral may skip 4 events
+    [TIO_BLE_PROFILE_LOW_POWER] = {0, 0, 0, TIO_BLE_PHY_1M, 320, 400, 4, 600},
+};
+
+static const tio_ble_link_ops_t *bleLinkOps = NULL;
+static tio_ble_link_t bleLink;
+static tio_ble_profile_e bleLinkProfile = TIO_BLE_PROFILE_DEFAULT;
+static volatile tio_ble_profile_e bleLinkRequested = TIO_BLE_PROFILE_DEFAULT;
+static tio_ble_link_state_e bleLinkState = TIO_BLE_LINK_IDLE;
+static uint32_t bleLinkStepStart = 0;
+static uint16_t bleLinkMaxMtu = TIO_BLE_LINK_MAX_MTU; // Largest MTU the WSF pool holds
+
+/**
+ * @brief Issue the request of a step, returning false if the step is skipped
+ */
+static bool
+tio_ble_link_request(tio_ble_link_state_e state)
+{
+    const tio_ble_link_profile_t *p = &bleLinkProfiles[bleLinkProfile];
+    uint16_t mtu = p->mtu > bleLinkMaxMtu ? bleLinkMaxMtu : p->mtu;
+    switch (state)
+    {
+    case TIO_BLE_LINK_MTU:
+        return mtu && mtu > bleLink.mtu && bleLinkOps->request_mtu(mtu) == 0;
+    case TIO_BLE_LINK_DATA_LEN:
+        return p->txOctets && p->txOctets > bleLink.tx_octets &&
+               bleLinkOps->request_data_len(p->txOctets, p->txTime) == 0;
+    case TIO_BLE_LINK_PHY:
+        return p->phy && p->phy != bleLink.phy && bleLinkOps->request_phy(p->phy) == 0;
+    case TIO_BLE_LINK_CONN_PARAMS:
+        return p->maxInterval &&
+               (bleLink.conn_interval < p->minInterval || bleLink.conn_interval > p->maxInterval ||
+                bleLink.conn_latency != p->latency) &&
+               bleLinkOps->request_conn_params(p->minInterval, p->maxInterval, p->latency, p->timeout) == 0;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Move on to the next step that needs a request
+ */
+static void
+tio_ble_link_advance(void)
+{
+    while (bleLinkState != TIO_BLE_LINK_DONE)
+    {
+        bleLinkState++;
+        if (tio_ble_link_request(bleLinkState))
+        {
+            bleLinkStepStart = bleLinkOps->now_ms();
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Complete the current step if an event of its kind arrived
+ */
+static void
+tio_ble_link_step_done(tio_ble_link_state_e state)
+{
+    if (bleLinkState == state)
+    {
+        tio_ble_link_advance();
+    }
+}
+
+void
+tio_ble_link_init(const tio_ble_link_ops_t *ops, tio_ble_profile_e profile, uint16_t maxMtu)
+{
+    bleLinkOps = ops;
+    bleLinkMaxMtu = maxMtu > TIO_BLE_LINK_MAX_MTU ? TIO_BLE_LINK_MAX_MTU : maxMtu;
+    bleLinkMaxMtu = bleLinkMaxMtu < TIO_BLE_LINK_DEFAULT_MTU ? TIO_BLE_LINK_DEFAULT_MTU : bleLinkMaxMtu;
+    bleLinkProfile = profile;
+    bleLinkRequested = profile;
+    bleLinkState = TIO_BLE_LINK_IDLE;
+    memset(&bleLink, 0, sizeof(bleLink));
+    bleLink.mtu = TIO_BLE_LINK_DEFAULT_MTU;
+}
+
+void
+tio_ble_link_poll(void)
+{
+    // Profile changes are applied from the BLE task, which owns the stack
+    if (bleLinkRequested != bleLinkProfile)
+    {
+        bleLinkProfile = bleLinkRequested;
+        if (bleLink.connected)
+        {
+            bleLinkState = TIO_BLE_LINK_IDLE;
+            tio_ble_link_advance();
+        }
+    }
+    if (bleLinkState == TIO_BLE_LINK_IDLE || bleLinkState == TIO_BLE_LINK_DONE)
+    {
+        return;
+    }
+    if (bleLinkOps->now_ms() - bleLinkStepStart >= TIO_BLE_LINK_STEP_TIMEOUT_MS)
+    {
+        tio_ble_link_advance();
+    }
+}
+
+void
+tio_ble_link_on_open(uint16_t interval, uint16_t latency, uint16_t timeout)
+{
+    memset(&bleLink, 0, sizeof(bleLink));
+    bleLink.connected = true;
+    bleLink.mtu = TIO_BLE_LINK_DEFAULT_MTU;
+    bleLink.tx_octets = 27;
+    bleLink.phy = TIO_BLE_PHY_1M;
+    bleLink.conn_interval = interval;
+    bleLink.conn_latency = latency;
+    bleLink.sup_timeout = timeout;
+    bleLinkState = TIO_BLE_LINK_IDLE;
+    tio_ble_link_advance();
+}
+
+void
+tio_ble_link_on_close(void)
+{
+    bleLink.connected = false;
+    bleLink.mtu = TIO_BLE_LINK_DEFAULT_MTU;
+    bleLinkState = TIO_BLE_LINK_IDLE;
+}
+
+void
+tio_ble_link_on_mtu(uint16_t mtu)
+{
+    bleLink.mtu = mtu;
+    tio_ble_link_step_done(TIO_BLE_LINK_MTU);
+}
+
+void
+tio_ble_link_on_data_len(uint16_t txOctets)
+{
+    bleLink.tx_octets = txOctets;
+    tio_ble_link_step_done(TIO_BLE_LINK_DATA_LEN);
+}
+
+void
+tio_ble_link_on_phy(uint8_t status, uint8_t phy)
+{
+    if (status == 0)
+    {
+        bleLink.phy = phy;
+    }
+    tio_ble_link_step_done(TIO_BLE_LINK_PHY);
+}
+
+void
+tio_ble_link_on_conn_params(uint8_t status, uint16_t interval, uint16_t latency, uint16_t timeout)
+{
+    if (status == 0)
+    {
+        bleLink.conn_interval = interval;
+        bleLink.conn_latency = latency;
+        bleLink.sup_timeout = timeout;
+    }
+    tio_ble_link_step_done(TIO_BLE_LINK_CONN_PARAMS);
+}
+
+uint32_t
+tio_ble_link_payload_len(void)
+{
+    // Notification value is MTU - 3 bytes, slot value adds a 2 byte LENGTH.
+    // A central may settle on a larger MTU than requested, notifications
+    // still have to fit the WSF pool buffers.
+    uint32_t mtu = bleLink.mtu > bleLinkMaxMtu ? bleLinkMaxMtu : bleLink.mtu;
+    uint32_t len = mtu - 3 - 2;
+    return len > TIO_BLE_SLOT_DATA_LEN ? TIO_BLE_SLOT_DATA_LEN : len;
+}
+
+uint32_t
+tio_ble_link_next_ms(void)
+{
+    if (bleLinkRequested != bleLinkProfile)
+    {
+        return 0;
+    }
+    if (bleLinkState == TIO_BLE_LINK_IDLE || bleLinkState == TIO_BLE_LINK_DONE)
+    {
+        return UINT32_MAX;
+    }
+    uint32_t elapsed = bleLinkOps->now_ms() - bleLinkStepStart;
+    return elapsed >= TIO_BLE_LINK_STEP_TIMEOUT_MS ? 0 : TIO_BLE_LINK_STEP_TIMEOUT_MS - elapsed;
+}
+
+uint32_t
+tio_ble_link_now_ms(void)
+{
+    return bleLinkOps ? bleLinkOps->now_ms() : 0;
+}
+
+/**
+ * @brief Request a link profile (applied now if connected, else on connect)
+ *
+ * @param profile Link profile
+ * @return uint32_t
+ */
+uint32_t
+tio_ble_set_profile(tio_ble_profile_e profile)
+{
+    if (profile > TIO_BLE_PROFILE_LOW_POWER)
+    {
+        return 1;
+    }
+    bleLinkRequested = profile;
+    tio_ble_wake();
+    return 0;
+}
+
+/**
+ * @brief Get the negotiated link parameters
+ *
+ * @param link Link parameters
+ */
+void
+tio_ble_get_link(tio_ble_link_t *link)
+{
+    *link = bleLink;
+    link->negotiating = bleLinkState != TIO_BLE_LINK_IDLE && bleLinkState != TIO_BLE_LINK_DONE;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file tio_ble_pool.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio BLE WSF buffer pool sizing and usage counters
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <string.h>
+#include "wsf_buf.h"
+
+#include "tio_ble_priv.h"
+
+static const wsfBufPoolDesc_t bleSmallPools[TIO_BLE_POOLS - 1] = {
+    {16, 8}, // 16 bytes, 8 buffers
+    {32, 4},
+    {64, 6}};
+
+static uint16_t blePoolLens[TIO_BLE_POOLS];
+static uint32_t blePoolFailed[TIO_BLE_POOLS];
+
+/**
+ * @brief Count a failed WSF allocation against the pool that should have served it
+ */
+static void
+tio_ble_pool_diag(WsfBufDiag_t *info)
+{
+    if (info->type != WSF_BUF_ALLOC_FAILED)
+    {
+        return;
+    }
+    uint32_t pool = 0;
+    while (pool < TIO_BLE_POOLS - 1 && info->param.alloc.len > blePoolLens[pool])
+    {
+        pool++;
+    }
+    blePoolFailed[pool]++;
+}
+
+uint32_t
+tio_ble_pool_size(const tio_ble_pool_config_t *cfg, bool stream, wsfBufPoolDesc_t *desc)
+{
+    uint32_t mtu = cfg->mtu ? cfg->mtu : TIO_BLE_POOL_MTU;
+    uint32_t depth = cfg->queue_depth ? cfg->queue_depth : TIO_BLE_POOL_DEPTH;
+    // Notifying characteristics, including UIO
+    uint32_t chars = (stream ? 1 : cfg->slots ? 2 * cfg->slots : TIO_BLE_SLOT_CHARS) + 1;
+    memcpy(desc, bleSmallPools, sizeof(bleSmallPools));
+    desc[TIO_BLE_POOLS - 1].len = TIO_BLE_POOL_LARGE_LEN(mtu);
+    desc[TIO_BLE_POOLS - 1].num = TIO_BLE_POOL_LARGE_BUFS(chars, depth);
+    return TIO_BLE_POOL_BYTES(chars, mtu, depth);
+}
+
+void
+tio_ble_pool_init(const wsfBufPoolDesc_t *desc)
+{
+    for (uint32_t pool = 0; pool < TIO_BLE_POOLS; pool++)
+    {
+        blePoolLens[pool] = desc[pool].len;
+    }
+    memset(blePoolFailed, 0, sizeof(blePoolFailed));
+    WsfBufDiagRegister(tio_ble_pool_diag);
+}
+
+/**
+ * @brief Get WSF buffer pool usage
+ *
+ * @param stats Pool usage, smallest buffers first
+ * @param maxPools Entries in stats
+ * @return uint32_t Number of pools reported
+ */
+uint32_t
+tio_ble_get_pool_stats(tio_ble_pool_stats_t *stats, uint32_t maxPools)
+{
+    uint32_t numPools = WsfBufGetNumPool();
+    numPools = numPools < maxPools ? numPools : maxPools;
+    for (uint32_t pool = 0; pool < numPools; pool++)
+    {
+        WsfBufPoolStat_t wsfStat;
+        WsfBufGetPoolStats(&wsfStat, pool);
+        stats[pool].buf_size = wsfStat.bufSize;
+        stats[pool].num_buf = wsfStat.numBuf;
+        stats[pool].num_alloc = wsfStat.numAlloc;
+        stats[pool].max_alloc = wsfStat.maxAlloc;
+        stats[pool].max_req_len = wsfStat.maxReqLen;
+        stats[pool].alloc_failed = pool < TIO_BLE_POOLS ? blePoolFailed[pool] : 0;
+    }
+    return numPools;
+}
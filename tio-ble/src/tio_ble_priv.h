@@ -0,0 +1,304 @@
+/**
+ * @file tio_ble_priv.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio BLE internals shared between service and TX paths
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __TIO_BLE_PRIV_H
+#define __TIO_BLE_PRIV_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ns_ble.h"
+#include "tio_ble.h"
+
+#define TIO_BLE_SLOTS TIO_SLOTS
+#define TIO_BLE_SLOT_BUF_LEN (242)
+#define TIO_BLE_SLOT_DATA_LEN (240)
+#define TIO_BLE_TX_STREAM (2) // Slot type of the stream characteristic queue
+
+// One characteristic per exposed slot type (TIO_SLOT_TABLE)
+#define TIO_BLE_SLOT_CHARS (TIO_SLOT_SIGNALS + TIO_SLOT_METRICS)
+#define TIO_BLE_SIG_CHARS (TIO_SLOT_SIGNALS ? TIO_SLOT_SIGNALS : 1)
+#define TIO_BLE_MET_CHARS (TIO_SLOT_METRICS ? TIO_SLOT_METRICS : 1)
+
+// WSF pools: three fixed pools for stack control messages plus one pool of
+// notification sized buffers. Pool storage and descriptors are both derived
+// from these, TIO_BLE_POOL_BYTES must match what wsfBufInit() carves out.
+#define TIO_BLE_POOLS 4
+#define TIO_BLE_POOL_SMALL_BYTES (16 * 8 + 32 * 4 + 64 * 6)
+#define TIO_BLE_POOL_HDR_LEN 16    // wsfBufPool_t per pool
+#define TIO_BLE_POOL_ACL_HDR_LEN 8 // HCI ACL + L2CAP headers ahead of the ATT PDU
+#define TIO_BLE_POOL_MIN_LARGE_LEN 128
+#define TIO_BLE_POOL_SPARE_BUFS 4  // Client writes, MTU/DLE/PHY procedures
+#define TIO_BLE_POOL_LARGE_LEN(mtu) \
+    ((((mtu) + TIO_BLE_POOL_ACL_HDR_LEN > TIO_BLE_POOL_MIN_LARGE_LEN ? (mtu) + TIO_BLE_POOL_ACL_HDR_LEN : TIO_BLE_POOL_MIN_LARGE_LEN) + 15) & ~15)
+#define TIO_BLE_POOL_LARGE_BUFS(chars, depth) ((chars) * (depth) + TIO_BLE_POOL_SPARE_BUFS)
+#define TIO_BLE_POOL_BYTES(chars, mtu, depth) \
+    (TIO_BLE_POOLS * TIO_BLE_POOL_HDR_LEN + TIO_BLE_POOL_SMALL_BYTES + \
+     TIO_BLE_POOL_LARGE_LEN(mtu) * TIO_BLE_POOL_LARGE_BUFS(chars, depth))
+// Per-slot layout: slot characteristics plus UIO
+#define TIO_BLE_POOL_MAX_BYTES TIO_BLE_POOL_BYTES(TIO_BLE_SLOT_CHARS + 1, TIO_BLE_POOL_MTU, TIO_BLE_POOL_DEPTH)
+
+#define TIO_BLE_LINK_DEFAULT_MTU 23
+#define TIO_BLE_LINK_MAX_MTU 247 // Fits a 251 byte LL payload
+#define TIO_BLE_LINK_STEP_TIMEOUT_MS 1000
+
+// Stack requests made by link negotiation, return 0 if issued
+typedef struct {
+    uint32_t (*now_ms)(void);
+    uint32_t (*request_mtu)(uint16_t mtu);
+    uint32_t (*request_data_len)(uint16_t txOctets, uint16_t txTime);
+    uint32_t (*request_phy)(uint8_t phy);
+    uint32_t (*request_conn_params)(uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t timeout);
+} tio_ble_link_ops_t;
+
+extern tio_ble_stats_t tioBleStats;
+
+/**
+ * @brief Reset TX queues and bind them to slot characteristics
+ *
+ * @param slotChars TIO_BLE_SLOT_CHARS characteristics, assigned in slot order
+ *                  (signal before metric) to the types TIO_SLOT_TABLE exposes
+ * @param streamChar Stream characteristic (queued as slot 0, type TIO_BLE_TX_STREAM)
+ */
+void
+tio_ble_tx_init(ns_ble_characteristic_t *slotChars, ns_ble_characteristic_t *streamChar);
+
+/**
+ * @brief Drop every queued notification and return all credits (link closed)
+ *
+ * Notifications the stack still held are gone w/ the connection, so their
+ * credits never come back through tio_ble_tx_credit().
+ */
+void
+tio_ble_tx_reset(void);
+
+/**
+ * @brief Get the characteristic of a slot type
+ *
+ * @param slot Slot number
+ * @param slotType Slot type
+ * @return ns_ble_characteristic_t* NULL if the slot doesn't expose the type
+ */
+ns_ble_characteristic_t *
+tio_ble_tx_char(uint8_t slot, uint8_t slotType);
+
+/**
+ * @brief Make room for a message of count notifications
+ *
+ * Metric slots drop their unsent notifications (latest message wins) when
+ * the message fits the queue, signal slots need count free FIFO entries.
+ * Callers serialize whole messages per queue (slot send mutex, stream
+ * accumulator) so no other message fills or conflates the queue before
+ * the count notifications are posted.
+ *
+ * @param slot Slot number
+ * @param slotType Slot type
+ * @param count Notifications in message
+ * @return uint32_t 0 if the message fits, 1 if it was refused
+ */
+uint32_t
+tio_ble_tx_begin(uint8_t slot, uint8_t slotType, uint32_t count);
+
+/**
+ * @brief Get queue fill of a slot type
+ *
+ * @param slot Slot number
+ * @param slotType Slot type
+ * @return uint32_t Percent of queue depth
+ */
+uint32_t
+tio_ble_tx_backlog(uint8_t slot, uint8_t slotType);
+
+/**
+ * @brief Queue one notification value (space taken by tio_ble_tx_begin())
+ *
+ * @param slot Slot number
+ * @param slotType Slot type
+ * @param value Characteristic value
+ * @param length Value length
+ */
+void
+tio_ble_tx_post(uint8_t slot, uint8_t slotType, const uint8_t *value, uint16_t length);
+
+/**
+ * @brief Send the next queued notification of a slot if it holds a credit (BLE task)
+ *
+ * @param slot Slot number
+ * @param slotType Slot type
+ */
+void
+tio_ble_tx_pump(uint8_t slot, uint8_t slotType);
+
+/**
+ * @brief Send the next notification of every queue holding a credit (BLE task)
+ */
+void
+tio_ble_tx_poll(void);
+
+/**
+ * @brief Return the credit of a characteristic whose notification completed
+ *
+ * @param c Characteristic
+ */
+void
+tio_ble_tx_credit(ns_ble_characteristic_t *c);
+
+/**
+ * @brief Send characteristic value as a notification, counting the outcome
+ *
+ * @param c Characteristic
+ * @param length Value bytes to put on air (the rest of the buffer is not sent)
+ * @return uint32_t
+ */
+uint32_t
+tio_ble_notify(ns_ble_characteristic_t *c, uint16_t length);
+
+/**
+ * @brief Derive WSF pool descriptors from a pool configuration
+ *
+ * @param cfg Pool configuration (0 fields take the build time value)
+ * @param stream Stream GATT layout (one notifying slot characteristic)
+ * @param desc TIO_BLE_POOLS descriptors to fill
+ * @return uint32_t Pool storage bytes the descriptors need
+ */
+uint32_t
+tio_ble_pool_size(const tio_ble_pool_config_t *cfg, bool stream, wsfBufPoolDesc_t *desc);
+
+/**
+ * @brief Reset pool counters and register for WSF allocation failures
+ *
+ * @param desc Descriptors the pool was sized with
+ */
+void
+tio_ble_pool_init(const wsfBufPoolDesc_t *desc);
+
+/**
+ * @brief Reset link state and set the profile requested on connect
+ *
+ * @param ops Stack requests
+ * @param profile Link profile
+ * @param maxMtu Largest ATT MTU the WSF pool buffers hold (caps the MTU
+ *               requested and the payload per notification)
+ */
+void
+tio_ble_link_init(const tio_ble_link_ops_t *ops, tio_ble_profile_e profile, uint16_t maxMtu);
+
+/**
+ * @brief Apply profile changes and time out unanswered requests (BLE task)
+ */
+void
+tio_ble_link_poll(void);
+
+// Link events from the stack (BLE task)
+void
+tio_ble_link_on_open(uint16_t interval, uint16_t latency, uint16_t timeout);
+void
+tio_ble_link_on_close(void);
+void
+tio_ble_link_on_mtu(uint16_t mtu);
+void
+tio_ble_link_on_data_len(uint16_t txOctets);
+void
+tio_ble_link_on_phy(uint8_t status, uint8_t phy);
+void
+tio_ble_link_on_conn_params(uint8_t status, uint16_t interval, uint16_t latency, uint16_t timeout);
+
+/**
+ * @brief Get max slot payload per notification for the negotiated MTU
+ *
+ * @return uint32_t
+ */
+uint32_t
+tio_ble_link_payload_len(void);
+
+/**
+ * @brief Get milliseconds until tio_ble_link_poll() has work
+ *
+ * @return uint32_t 0 if due now, UINT32_MAX if nothing pending
+ */
+uint32_t
+tio_ble_link_next_ms(void);
+
+/**
+ * @brief Get milliseconds from the link's time source
+ *
+ * @return uint32_t
+ */
+uint32_t
+tio_ble_link_now_ms(void);
+
+/**
+ * @brief Reset stream accumulator
+ *
+ * @param deadlineMs Max time a record waits for more records (0 - flush on every send)
+ * @param tickUs Optional tick source for time records
+ * @return uint32_t 0 if ready, 1 if its mutex couldn't be created
+ */
+uint32_t
+tio_ble_stream_init(uint32_t deadlineMs, pfnTickUs tickUs);
+
+/**
+ * @brief Drop accumulated records (link closed)
+ */
+void
+tio_ble_stream_reset(void);
+
+/**
+ * @brief Add slot data to the stream as records, all or none
+ *
+ * Codec data is encoded before taking the stream lock, into at most
+ * TIO_BLE_SIG_QUEUE_DEPTH + 1 blocks on the caller's stack.
+ *
+ * @param slot Slot number
+ * @param slotType Slot type
+ * @param codec Codec ID (TIO_CODEC_NONE - raw data)
+ * @param data Slot data
+ * @param length Data length
+ * @param rate Decimation factor of signal samples (1 - full rate)
+ * @return uint32_t 0 if queued, 1 if refused
+ */
+uint32_t
+tio_ble_stream_send(uint8_t slot, uint8_t slotType, uint8_t codec, const uint8_t *data, uint32_t length,
+                    uint8_t rate);
+
+/**
+ * @brief Add encoded blocks to the stream as codec records, all or none
+ *
+ * @param slot Slot number
+ * @param blocks Encoded blocks back to back
+ * @param blockLens Block lengths
+ * @param numBlocks Number of blocks
+ * @param rate Decimation factor of the samples (1 - full rate)
+ * @return uint32_t 0 if queued, 1 if refused
+ */
+uint32_t
+tio_ble_stream_send_blocks(uint8_t slot, const uint8_t *blocks, const uint16_t *blockLens, uint32_t numBlocks,
+                           uint8_t rate);
+
+/**
+ * @brief Flush the stream accumulator once its deadline passed (BLE task)
+ */
+void
+tio_ble_stream_poll(void);
+
+/**
+ * @brief Get milliseconds until the stream accumulator is due
+ *
+ * @return uint32_t 0 if due now, UINT32_MAX if empty or the stream queue is full
+ */
+uint32_t
+tio_ble_stream_next_ms(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __TIO_BLE_PRIV_H
@@ -0,0 +1,403 @@
+/**
+ * @file tio_ble_stream.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio BLE stream characteristic multiplexing slot records
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <string.h>
+#include "ns_ambiqsuite_harness.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "tio_ble_priv.h"
+#include "tio_codec.h"
+
+#define TIO_BLE_REC_HDR_LEN (2)
+#define TIO_BLE_REC_FRAG_HDR_LEN (3)
+#define TIO_BLE_REC_TIME_LEN (4)
+#define TIO_BLE_REC_RATE_LEN (1)
+// Codec data is encoded on the sender's stack into at most as many blocks
+// as the stream queue and accumulator can take
+#define TIO_BLE_STREAM_STAGE_BLOCKS (TIO_BLE_SIG_QUEUE_DEPTH + 1)
+
+// Records accumulate in one notification value until the next one doesn't
+// fit or the oldest record waited bleStreamDeadlineMs. Senders and the BLE
+// task hold bleStreamMutex while they touch the accumulator or stream queue.
+static uint8_t bleStreamValue[TIO_BLE_SLOT_BUF_LEN];
+static uint16_t bleStreamLen = 0;
+static uint32_t bleStreamStart = 0;
+static uint32_t bleStreamDeadlineMs = 0;
+static uint8_t bleStreamMsgId = 0;
+static pfnTickUs bleStreamTickUs = NULL;
+static SemaphoreHandle_t bleStreamMutex = NULL;
+
+/**
+ * @brief Get notification value capacity for the negotiated MTU
+ */
+static inline uint32_t
+tio_ble_stream_capacity(void)
+{
+    return tio_ble_link_payload_len() + 2;
+}
+
+/**
+ * @brief Queue accumulated records as one notification (caller holds bleStreamMutex)
+ *
+ * @return uint32_t 0 if queued or empty, 1 if stream queue is full
+ */
+static uint32_t
+tio_ble_stream_flush(void)
+{
+    if (bleStreamLen == 0)
+    {
+        return 0;
+    }
+    // Records wait in the accumulator while the queue is full, nothing is dropped
+    if (tio_ble_tx_backlog(0, TIO_BLE_TX_STREAM) >= 100 || tio_ble_tx_begin(0, TIO_BLE_TX_STREAM, 1))
+    {
+        return 1;
+    }
+    tio_ble_tx_post(0, TIO_BLE_TX_STREAM, bleStreamValue, bleStreamLen);
+    bleStreamLen = 0;
+    return 0;
+}
+
+/**
+ * @brief Get bytes a record's payload starts w/ (decimation factor of signal records)
+ */
+static inline uint32_t
+tio_ble_stream_tag_len(uint8_t rate)
+{
+    return rate > 1 ? TIO_BLE_REC_RATE_LEN : 0;
+}
+
+/**
+ * @brief Count a record into a message's plan
+ *
+ * @param len Accumulated bytes so far, updated
+ * @param recLen Record bytes w/ header and tag
+ * @return uint32_t 1 if the record starts a new notification, queueing the accumulated one
+ */
+static uint32_t
+tio_ble_stream_plan(uint32_t *len, uint32_t recLen)
+{
+    if (*len + recLen > tio_ble_stream_capacity())
+    {
+        uint32_t filled = *len != 0;
+        *len = recLen;
+        return filled;
+    }
+    *len += recLen;
+    return 0;
+}
+
+/**
+ * @brief Start a message, planning its time record (takes bleStreamMutex)
+ *
+ * @param len Accumulated bytes, set to the accumulator plus the time record
+ * @return uint32_t Notifications queued so far
+ */
+static uint32_t
+tio_ble_stream_lock(uint32_t *len)
+{
+    xSemaphoreTake(bleStreamMutex, portMAX_DELAY);
+    *len = bleStreamLen;
+    return bleStreamTickUs ? tio_ble_stream_plan(len, TIO_BLE_REC_HDR_LEN + TIO_BLE_REC_TIME_LEN) : 0;
+}
+
+/**
+ * @brief Check the stream queue takes every notification a message fills
+ * (caller holds bleStreamMutex)
+ *
+ * Only the BLE task takes entries off the stream queue, so the flushes
+ * that follow can't be refused.
+ *
+ * @param notes Notifications the message queues
+ * @return uint32_t 0 if the message fits, 1 if it was refused
+ */
+static inline uint32_t
+tio_ble_stream_reserve(uint32_t notes)
+{
+    return notes ? tio_ble_tx_begin(0, TIO_BLE_TX_STREAM, notes) : 0;
+}
+
+/**
+ * @brief Append a record, flushing the accumulator if needed (caller holds
+ * bleStreamMutex, room checked by tio_ble_stream_reserve())
+ *
+ * Decimated signal records are retyped and start w/ the decimation factor.
+ *
+ * @param hdr Record header byte
+ * @param length Record payload length
+ * @param rate Decimation factor (1 - full rate)
+ * @return uint8_t* Record payload or NULL if stream queue is full
+ */
+static uint8_t *
+tio_ble_stream_record(uint8_t hdr, uint32_t length, uint8_t rate)
+{
+    bool signal = (hdr & TIO_BLE_REC_TYPE_MASK) == (TIO_SLOT_SIGNAL << TIO_BLE_REC_TYPE_SHIFT);
+    uint32_t tagLen = signal ? tio_ble_stream_tag_len(rate) : 0;
+    if (tagLen)
+    {
+        hdr |= TIO_BLE_REC_TYPE_RATE << TIO_BLE_REC_TYPE_SHIFT;
+        length += tagLen;
+    }
+    if (bleStreamLen + TIO_BLE_REC_HDR_LEN + length > tio_ble_stream_capacity() && tio_ble_stream_flush())
+    {
+        return NULL;
+    }
+    if (bleStreamLen == 0)
+    {
+        bleStreamStart = tio_ble_link_now_ms();
+    }
+    uint8_t *rec = bleStreamValue + bleStreamLen;
+    rec[0] = hdr;
+    rec[1] = length;
+    if (tagLen)
+    {
+        rec[TIO_BLE_REC_HDR_LEN] = rate;
+    }
+    bleStreamLen += TIO_BLE_REC_HDR_LEN + length;
+    return rec + TIO_BLE_REC_HDR_LEN + tagLen;
+}
+
+/**
+ * @brief Append a time record for the records that follow (caller holds bleStreamMutex)
+ *
+ * @param now Tick taken before the lock
+ */
+static void
+tio_ble_stream_time(uint32_t now)
+{
+    if (bleStreamTickUs == NULL)
+    {
+        return;
+    }
+    uint8_t *rec = tio_ble_stream_record(TIO_BLE_REC_TYPE_TIME << TIO_BLE_REC_TYPE_SHIFT, TIO_BLE_REC_TIME_LEN, 1);
+    if (rec != NULL)
+    {
+        rec[0] = now & 0xFF;
+        rec[1] = (now >> 8) & 0xFF;
+        rec[2] = (now >> 16) & 0xFF;
+        rec[3] = (now >> 24) & 0xFF;
+    }
+}
+
+/**
+ * @brief Queue the accumulator if records may not wait, release
+ * bleStreamMutex and wake the BLE task
+ */
+static void
+tio_ble_stream_done(void)
+{
+    if (bleStreamDeadlineMs == 0 || tio_ble_link_now_ms() - bleStreamStart >= bleStreamDeadlineMs)
+    {
+        tio_ble_stream_flush();
+    }
+    xSemaphoreGive(bleStreamMutex);
+    tio_ble_wake();
+}
+
+/**
+ * @brief Add encoded blocks as codec records, all or none
+ *
+ * @param hdr Record header byte (w/o flags)
+ * @param blocks Encoded blocks back to back
+ * @param blockLens Block lengths
+ * @param numBlocks Number of blocks
+ * @param rate Decimation factor of the samples (1 - full rate)
+ * @param now Tick for the time record
+ * @return uint32_t 0 if queued, 1 if refused
+ */
+static uint32_t
+tio_ble_stream_add_blocks(uint8_t hdr, const uint8_t *blocks, const uint16_t *blockLens, uint32_t numBlocks,
+                          uint8_t rate, uint32_t now)
+{
+    uint32_t len;
+    uint32_t notes = tio_ble_stream_lock(&len);
+    uint32_t recHdrLen = TIO_BLE_REC_HDR_LEN + tio_ble_stream_tag_len(rate);
+    for (uint32_t i = 0; i < numBlocks; i++)
+    {
+        // Link may have renegotiated a smaller MTU since the blocks were encoded
+        if (recHdrLen + blockLens[i] > tio_ble_stream_capacity())
+        {
+            tioBleStats.tx_dropped++;
+            xSemaphoreGive(bleStreamMutex);
+            return 1;
+        }
+        notes += tio_ble_stream_plan(&len, recHdrLen + blockLens[i]);
+    }
+    if (tio_ble_stream_reserve(notes))
+    {
+        xSemaphoreGive(bleStreamMutex);
+        return 1;
+    }
+    tio_ble_stream_time(now);
+    for (uint32_t i = 0; i < numBlocks; i++)
+    {
+        uint8_t *rec = tio_ble_stream_record(hdr | TIO_BLE_REC_FLAG_CODEC, blockLens[i], rate);
+        if (rec == NULL)
+        {
+            break;
+        }
+        memcpy(rec, blocks, blockLens[i]);
+        blocks += blockLens[i];
+    }
+    tio_ble_stream_done();
+    return 0;
+}
+
+uint32_t
+tio_ble_stream_init(uint32_t deadlineMs, pfnTickUs tickUs)
+{
+    if (bleStreamMutex == NULL)
+    {
+        bleStreamMutex = xSemaphoreCreateMutex();
+        if (bleStreamMutex == NULL)
+        {
+            return 1;
+        }
+    }
+    bleStreamLen = 0;
+    bleStreamDeadlineMs = deadlineMs;
+    bleStreamTickUs = tickUs;
+    return 0;
+}
+
+void
+tio_ble_stream_reset(void)
+{
+    xSemaphoreTake(bleStreamMutex, portMAX_DELAY);
+    bleStreamLen = 0;
+    xSemaphoreGive(bleStreamMutex);
+}
+
+uint32_t
+tio_ble_stream_send(uint8_t slot, uint8_t slotType, uint8_t codec, const uint8_t *data, uint32_t length,
+                    uint8_t rate)
+{
+    uint8_t hdr = slot | (slotType << TIO_BLE_REC_TYPE_SHIFT);
+    uint32_t now = bleStreamTickUs ? bleStreamTickUs() : 0;
+    rate = slotType == TIO_SLOT_SIGNAL ? rate : 1;
+    if (codec != TIO_CODEC_NONE)
+    {
+        // Encode outside the lock, one block per record sized to a full notification
+        uint8_t stage[TIO_BLE_STREAM_STAGE_BLOCKS * TIO_BLE_SLOT_DATA_LEN];
+        uint16_t stageLens[TIO_BLE_STREAM_STAGE_BLOCKS];
+        const int16_t *samples = (const int16_t *)data;
+        uint32_t count = length / 2;
+        uint32_t numBlocks = 0;
+        uint32_t staged = 0;
+        uint32_t maxLen = tio_ble_stream_capacity() - TIO_BLE_REC_HDR_LEN - tio_ble_stream_tag_len(rate);
+        for (; count && numBlocks < TIO_BLE_STREAM_STAGE_BLOCKS; numBlocks++)
+        {
+            uint32_t encoded;
+            stageLens[numBlocks] = tio_codec_encode(codec, samples, count, stage + staged, maxLen, &encoded);
+            if (stageLens[numBlocks] == 0)
+            {
+                return 1;
+            }
+            staged += stageLens[numBlocks];
+            samples += encoded;
+            count -= encoded;
+        }
+        if (count)
+        {
+            // More blocks than the stream queue holds
+            tioBleStats.tx_dropped++;
+            return 1;
+        }
+        return tio_ble_stream_add_blocks(hdr, stage, stageLens, numBlocks, rate, now);
+    }
+    uint32_t len;
+    uint32_t notes = tio_ble_stream_lock(&len);
+    uint32_t recHdrLen = TIO_BLE_REC_HDR_LEN + tio_ble_stream_tag_len(rate);
+    uint32_t maxLen = tio_ble_stream_capacity() - recHdrLen;
+    // Larger messages are split into fragment records
+    uint32_t fragDataLen = maxLen - TIO_BLE_REC_FRAG_HDR_LEN;
+    uint32_t count = length <= maxLen ? 1 : (length + fragDataLen - 1) / fragDataLen;
+    if (count > 255)
+    {
+        xSemaphoreGive(bleStreamMutex);
+        return 1;
+    }
+    for (uint32_t index = 0; index < count; index++)
+    {
+        uint32_t offset = index * fragDataLen;
+        uint32_t fragLen = length - offset > fragDataLen ? fragDataLen : length - offset;
+        uint32_t recLen = count == 1 ? length : fragLen + TIO_BLE_REC_FRAG_HDR_LEN;
+        notes += tio_ble_stream_plan(&len, recHdrLen + recLen);
+    }
+    if (tio_ble_stream_reserve(notes))
+    {
+        xSemaphoreGive(bleStreamMutex);
+        return 1;
+    }
+    tio_ble_stream_time(now);
+    if (count == 1)
+    {
+        uint8_t *rec = tio_ble_stream_record(hdr, length, rate);
+        if (rec != NULL)
+        {
+            memcpy(rec, data, length);
+        }
+        tio_ble_stream_done();
+        return 0;
+    }
+    uint8_t msgId = bleStreamMsgId++;
+    for (uint32_t index = 0; index < count; index++)
+    {
+        uint32_t offset = index * fragDataLen;
+        uint32_t fragLen = length - offset > fragDataLen ? fragDataLen : length - offset;
+        uint8_t *rec = tio_ble_stream_record(hdr | TIO_BLE_REC_FLAG_FRAG, fragLen + TIO_BLE_REC_FRAG_HDR_LEN, rate);
+        if (rec == NULL)
+        {
+            break;
+        }
+        rec[0] = msgId;
+        rec[1] = index;
+        rec[2] = count;
+        memcpy(rec + TIO_BLE_REC_FRAG_HDR_LEN, data + offset, fragLen);
+    }
+    tio_ble_stream_done();
+    return 0;
+}
+
+uint32_t
+tio_ble_stream_send_blocks(uint8_t slot, const uint8_t *blocks, const uint16_t *blockLens, uint32_t numBlocks,
+                           uint8_t rate)
+{
+    uint32_t now = bleStreamTickUs ? bleStreamTickUs() : 0;
+    return tio_ble_stream_add_blocks(slot, blocks, blockLens, numBlocks, rate, now);
+}
+
+void
+tio_ble_stream_poll(void)
+{
+    xSemaphoreTake(bleStreamMutex, portMAX_DELAY);
+    if (bleStreamLen && tio_ble_link_now_ms() - bleStreamStart >= bleStreamDeadlineMs)
+    {
+        tio_ble_stream_flush();
+    }
+    xSemaphoreGive(bleStreamMutex);
+    tio_ble_tx_pump(0, TIO_BLE_TX_STREAM);
+}
+
+uint32_t
+tio_ble_stream_next_ms(void)
+{
+    // A full queue can't take the accumulator, the returning credit wakes
+    // the BLE task and tio_ble_stream_poll() flushes then
+    if (bleStreamLen == 0 || tio_ble_tx_backlog(0, TIO_BLE_TX_STREAM) >= 100)
+    {
+        return UINT32_MAX;
+    }
+    uint32_t elapsed = tio_ble_link_now_ms() - bleStreamStart;
+    return elapsed >= bleStreamDeadlineMs ? 0 : bleStreamDeadlineMs - elapsed;
+}
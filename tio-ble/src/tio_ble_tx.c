@@ -0,0 +1,268 @@
+/**
+ * @file tio_ble_tx.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio BLE credit-based notification queues
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "ns_ambiqsuite_harness.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "ns_ble.h"
+
+#include "tio_ble_priv.h"
+
+// Each slot characteristic has one credit: a notification is only handed to
+// the stack once the previous one completed (notify handler), so queued
+// values wait here rather than in the WSF pool.
+typedef struct
+{
+    ns_ble_characteristic_t *c;
+    uint8_t (*entries)[TIO_BLE_SLOT_BUF_LEN];
+    uint16_t *lengths;
+    uint8_t depth;
+    uint8_t head;
+    uint8_t count;
+    bool conflate;      // Latest value wins (metric slots)
+    bool inFlight;      // Credit taken
+    uint16_t retryLen;  // Characteristic value the stack refused, resent first
+} tio_ble_queue_t;
+
+// Queue storage only for the types each slot exposes (TIO_SLOT_TABLE)
+static uint8_t bleSigEntries[TIO_BLE_SIG_CHARS][TIO_BLE_SIG_QUEUE_DEPTH][TIO_BLE_SLOT_BUF_LEN];
+static uint16_t bleSigLengths[TIO_BLE_SIG_CHARS][TIO_BLE_SIG_QUEUE_DEPTH];
+static uint8_t bleMetEntries[TIO_BLE_MET_CHARS][TIO_BLE_MET_QUEUE_DEPTH][TIO_BLE_SLOT_BUF_LEN];
+static uint16_t bleMetLengths[TIO_BLE_MET_CHARS][TIO_BLE_MET_QUEUE_DEPTH];
+
+static uint8_t bleStreamEntries[TIO_BLE_SIG_QUEUE_DEPTH][TIO_BLE_SLOT_BUF_LEN];
+static uint16_t bleStreamLengths[TIO_BLE_SIG_QUEUE_DEPTH];
+
+// Queue i notifies on slot characteristic i, bleQueueIdx maps slot and type to it
+static tio_ble_queue_t bleQueues[TIO_BLE_SLOT_CHARS];
+static uint8_t bleQueueIdx[TIO_BLE_SLOTS][2];
+static ns_ble_characteristic_t *bleSlotChars = NULL;
+static tio_ble_queue_t bleStreamQueue;
+
+static inline tio_ble_queue_t *
+tio_ble_tx_queue(uint8_t slot, uint8_t slotType)
+{
+    return slotType == TIO_BLE_TX_STREAM ? &bleStreamQueue : &bleQueues[bleQueueIdx[slot][slotType]];
+}
+
+tio_ble_stats_t tioBleStats = {0};
+
+uint32_t
+tio_ble_notify(ns_ble_characteristic_t *c, uint16_t length)
+{
+    c->valueLen = length;
+    if (ns_ble_send_value(c, NULL) != NS_STATUS_SUCCESS)
+    {
+        tioBleStats.tx_errors++;
+        return 1;
+    }
+    tioBleStats.tx_frames++;
+    tioBleStats.tx_bytes += length;
+    return 0;
+}
+
+void
+tio_ble_tx_init(ns_ble_characteristic_t *slotChars, ns_ble_characteristic_t *streamChar)
+{
+    uint32_t sig = 0;
+    uint32_t met = 0;
+    bleSlotChars = slotChars;
+    bleStreamQueue = (tio_ble_queue_t){
+        .c = streamChar,
+        .entries = bleStreamEntries,
+        .lengths = bleStreamLengths,
+        .depth = TIO_BLE_SIG_QUEUE_DEPTH,
+        .conflate = false};
+    // Characteristics in slot order, signal before metric
+    for (uint32_t slot = 0; slot < TIO_BLE_SLOTS; slot++)
+    {
+        if (tio_slot_valid(slot, TIO_SLOT_SIGNAL))
+        {
+            bleQueueIdx[slot][TIO_SLOT_SIGNAL] = sig + met;
+            bleQueues[sig + met] = (tio_ble_queue_t){
+                .c = &slotChars[sig + met],
+                .entries = bleSigEntries[sig],
+                .lengths = bleSigLengths[sig],
+                .depth = TIO_BLE_SIG_QUEUE_DEPTH,
+                .conflate = false};
+            sig++;
+        }
+        if (tio_slot_valid(slot, TIO_SLOT_METRIC))
+        {
+            bleQueueIdx[slot][TIO_SLOT_METRIC] = sig + met;
+            bleQueues[sig + met] = (tio_ble_queue_t){
+                .c = &slotChars[sig + met],
+                .entries = bleMetEntries[met],
+                .lengths = bleMetLengths[met],
+                .depth = TIO_BLE_MET_QUEUE_DEPTH,
+                .conflate = true};
+            met++;
+        }
+    }
+}
+
+/**
+ * @brief Drop queued and refused notifications, return the credit
+ */
+static void
+tio_ble_tx_clear(tio_ble_queue_t *q)
+{
+    q->head = 0;
+    q->count = 0;
+    q->inFlight = false;
+    q->retryLen = 0;
+}
+
+void
+tio_ble_tx_reset(void)
+{
+    taskENTER_CRITICAL();
+    for (uint32_t i = 0; i < TIO_BLE_SLOT_CHARS; i++)
+    {
+        tio_ble_tx_clear(&bleQueues[i]);
+    }
+    tio_ble_tx_clear(&bleStreamQueue);
+    taskEXIT_CRITICAL();
+}
+
+ns_ble_characteristic_t *
+tio_ble_tx_char(uint8_t slot, uint8_t slotType)
+{
+    return tio_slot_valid(slot, slotType) ? bleQueues[bleQueueIdx[slot][slotType]].c : NULL;
+}
+
+uint32_t
+tio_ble_tx_begin(uint8_t slot, uint8_t slotType, uint32_t count)
+{
+    tio_ble_queue_t *q = tio_ble_tx_queue(slot, slotType);
+    uint32_t rc = 0;
+    taskENTER_CRITICAL();
+    if (q->conflate && count <= q->depth)
+    {
+        tioBleStats.tx_coalesced += q->count + (q->retryLen ? 1 : 0);
+        q->count = 0;
+        q->retryLen = 0;
+    }
+    else if (count > (uint32_t)(q->depth - q->count))
+    {
+        tioBleStats.tx_dropped++;
+        rc = 1;
+    }
+    taskEXIT_CRITICAL();
+    return rc;
+}
+
+uint32_t
+tio_ble_tx_backlog(uint8_t slot, uint8_t slotType)
+{
+    tio_ble_queue_t *q = tio_ble_tx_queue(slot, slotType);
+    return q->count * 100U / q->depth;
+}
+
+void
+tio_ble_tx_post(uint8_t slot, uint8_t slotType, const uint8_t *value, uint16_t length)
+{
+    tio_ble_queue_t *q = tio_ble_tx_queue(slot, slotType);
+    taskENTER_CRITICAL();
+    uint8_t tail = (q->head + q->count) % q->depth;
+    memcpy(q->entries[tail], value, length);
+    q->lengths[tail] = length;
+    q->count++;
+    taskEXIT_CRITICAL();
+}
+
+static void
+tio_ble_tx_pump_queue(tio_ble_queue_t *q)
+{
+    uint16_t length;
+    taskENTER_CRITICAL();
+    if (q->c == NULL || q->inFlight || (q->count == 0 && q->retryLen == 0))
+    {
+        taskEXIT_CRITICAL();
+        return;
+    }
+    // Characteristic value is only written while holding the credit
+    length = q->retryLen;
+    if (length == 0)
+    {
+        length = q->lengths[q->head];
+        memcpy(q->c->applicationValue, q->entries[q->head], length);
+        q->head = (q->head + 1) % q->depth;
+        q->count--;
+    }
+    q->inFlight = true;
+    taskEXIT_CRITICAL();
+
+    uint32_t failed = tio_ble_notify(q->c, length);
+    taskENTER_CRITICAL();
+    // Retry a refused value on the next send or credit (unless superseded)
+    q->retryLen = failed ? length : 0;
+    q->inFlight = !failed;
+    taskEXIT_CRITICAL();
+}
+
+void
+tio_ble_tx_pump(uint8_t slot, uint8_t slotType)
+{
+    tio_ble_tx_pump_queue(tio_ble_tx_queue(slot, slotType));
+}
+
+void
+tio_ble_tx_poll(void)
+{
+    tio_ble_tx_pump(0, TIO_BLE_TX_STREAM);
+    for (uint32_t i = 0; i < TIO_BLE_SLOT_CHARS; i++)
+    {
+        tio_ble_tx_pump_queue(&bleQueues[i]);
+    }
+}
+
+void
+tio_ble_tx_credit(ns_ble_characteristic_t *c)
+{
+    tio_ble_queue_t *q = NULL;
+    if (c != NULL && c == bleStreamQueue.c)
+    {
+        q = &bleStreamQueue;
+    }
+    else if (bleSlotChars != NULL && c >= bleSlotChars && c < bleSlotChars + TIO_BLE_SLOT_CHARS)
+    {
+        q = &bleQueues[c - bleSlotChars];
+    }
+    if (q != NULL)
+    {
+        q->inFlight = false;
+        tio_ble_tx_pump_queue(q);
+    }
+}
+
+/**
+ * @brief Get number of notifications a slot can still queue
+ *
+ * @param slot Slot number
+ * @param slot_type Slot type (0 - signal, 1 - metric)
+ * @return uint32_t Free queue entries (metric slots always accept a new value,
+ *                  stream mode reports free stream notifications for all slots)
+ */
+uint32_t
+tio_ble_slot_space(uint8_t slot, uint8_t slot_type)
+{
+    if (!tio_slot_valid(slot, slot_type))
+    {
+        return 0;
+    }
+    tio_ble_queue_t *q = bleStreamQueue.c ? &bleStreamQueue : tio_ble_tx_queue(slot, slot_type);
+    if (q->conflate)
+    {
+        return q->depth;
+    }
+    return q->depth - q->count;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file tio_codec.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio signal sample codecs
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __TIO_CODEC_H
+#define __TIO_CODEC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// Encoded block of int16 samples:
+//   CODEC: 1 byte      [TIO_CODEC_*]
+//   COUNT: 2 bytes     [Samples in block]
+//    BODY: ...
+// Each block is self-contained so a lost frame never corrupts the next one.
+//
+// DELTA_VARINT body: zigzag first order deltas (first sample from 0) as
+//   LEB128 varints (1-3 bytes each)
+// DELTA_BITPACK body: WIDTH (1 byte), first sample (2 bytes), then COUNT-1
+//   zigzag deltas packed LSB first in WIDTH bits each
+#define TIO_CODEC_NONE 0
+#define TIO_CODEC_DELTA_VARINT 1
+#define TIO_CODEC_DELTA_BITPACK 2
+
+#define TIO_CODEC_HDR_LEN 3
+
+/**
+ * @brief Encode as many samples as fit into a block
+ *
+ * @param codec Codec ID (TIO_CODEC_DELTA_*)
+ * @param samples Samples
+ * @param count Number of samples
+ * @param dst Block buffer
+ * @param dstLen Block buffer length
+ * @param encoded Number of samples encoded
+ * @return uint32_t Block length or 0 if nothing fit
+ */
+uint32_t
+tio_codec_encode(uint8_t codec, const int16_t *samples, uint32_t count, uint8_t *dst, uint32_t dstLen, uint32_t *encoded);
+
+/**
+ * @brief Get the most blocks encoding given samples can take
+ *
+ * Assumes every delta is as wide as it gets, so senders can check for room
+ * before encoding.
+ *
+ * @param codec Codec ID (TIO_CODEC_DELTA_*)
+ * @param count Number of samples
+ * @param dstLen Block buffer length
+ * @return uint32_t Blocks or 0 if codec is invalid or dstLen can't hold a sample
+ */
+uint32_t
+tio_codec_max_blocks(uint8_t codec, uint32_t count, uint32_t dstLen);
+
+/**
+ * @brief Decode a block
+ *
+ * @param src Block
+ * @param srcLen Block length
+ * @param samples Decoded samples
+ * @param maxCount Sample buffer length
+ * @param count Number of samples decoded
+ * @return uint32_t 0 on success, 1 if block is malformed or too large
+ */
+uint32_t
+tio_codec_decode(const uint8_t *src, uint32_t srcLen, int16_t *samples, uint32_t maxCount, uint32_t *count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __TIO_CODEC_H
@@ -0,0 +1,238 @@
+/**
+ * @file tio_core.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio transport-agnostic slot model and fan-out
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __TIO_CORE_H
+#define __TIO_CORE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Slot table: one X(slot, signal, metric) entry per slot, numbered from 0 in
+// order, w/ signal/metric 1 if the slot exposes that type (0 costs no
+// transport buffers). Boards w/ more channels define TIO_SLOT_TABLE_FILE as a
+// header that defines TIO_SLOT_TABLE.
+#ifdef TIO_SLOT_TABLE_FILE
+#include TIO_SLOT_TABLE_FILE
+#endif
+#ifndef TIO_SLOT_TABLE
+#define TIO_SLOT_TABLE(X) \
+    X(0, 1, 1)            \
+    X(1, 1, 1)            \
+    X(2, 1, 1)            \
+    X(3, 1, 1)
+#endif
+
+#define TIO_SLOT_COUNT_(slot, sig, met) +1
+#define TIO_SLOT_SIG_COUNT_(slot, sig, met) +(sig)
+#define TIO_SLOT_MET_COUNT_(slot, sig, met) +(met)
+#define TIO_SLOT_TYPES_(slot, sig, met) (sig) | (met) << 1,
+
+#define TIO_SLOTS (0 TIO_SLOT_TABLE(TIO_SLOT_COUNT_))
+#define TIO_SLOT_SIGNALS (0 TIO_SLOT_TABLE(TIO_SLOT_SIG_COUNT_)) // Slots exposing a signal
+#define TIO_SLOT_METRICS (0 TIO_SLOT_TABLE(TIO_SLOT_MET_COUNT_)) // Slots exposing a metric
+#define TIO_SLOT_MAX 16 // Slot numbers must fit 4 bits (BLE stream records)
+
+typedef enum {
+    TIO_SLOT_SIGNAL = 0,
+    TIO_SLOT_METRIC,
+    TIO_SLOT_UIO,
+} tio_slot_type_e;
+
+// Shared by every transport's receive path
+typedef void (*pfnSlotUpdate)(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length);
+typedef void (*pfnUioUpdate)(const uint8_t *data, uint32_t length);
+typedef uint32_t (*pfnTickUs)(void);
+
+#ifndef TIO_CORE_BLOCK_BUF_LEN
+#define TIO_CORE_BLOCK_BUF_LEN 2048 // Encoded blocks of one slot update
+#endif
+#define TIO_CORE_MAX_BLOCKS 64
+
+// Sample accumulators: tio_slot_push_samples() packs samples into one of two
+// buffers per signal slot and sends it once no further sample fits the
+// smallest transport payload (at most TIO_CORE_ACC_LEN bytes) or the oldest
+// sample waited the slot's max_latency_us. A buffer every transport refused
+// is kept and retried before the next one; it is dropped if the other buffer
+// fills up meanwhile.
+#ifndef TIO_CORE_ACC_LEN
+#define TIO_CORE_ACC_LEN 248 // USB DATA field
+#endif
+#define TIO_CORE_ACC_SLOTS (TIO_SLOT_SIGNALS ? TIO_SLOT_SIGNALS : 1)
+
+// Rate control: slots w/ rate_control on step int16 samples pushed through
+// tio_slot_push_samples() down to the next rate_factors entry when a buffer
+// is refused or a transport's backlog for the slot reaches
+// TIO_RATE_BACKLOG_HIGH percent (one step per TIO_RATE_HOLD such buffers),
+// and back up after TIO_RATE_RECOVER buffers in a row went out w/ every
+// backlog at or under TIO_RATE_BACKLOG_LOW percent. Samples are low-pass
+// filtered and decimated w/ CMSIS-DSP arm_fir_decimate_q15(), and transports
+// tag each frame w/ the decimation factor so the host can resample. A slot
+// stays at full rate while any transport w/ its link up can't (rate_tag).
+#define TIO_RATE_STEPS 4       // Steps below full rate
+#define TIO_RATE_MAX_FACTOR 8  // Largest decimation factor
+#define TIO_RATE_TAPS 24       // Anti-aliasing FIR length
+#define TIO_RATE_BLOCK 16      // Output samples per decimator call
+#define TIO_RATE_BACKLOG_HIGH 75
+#define TIO_RATE_BACKLOG_LOW 25
+#define TIO_RATE_HOLD 4
+#define TIO_RATE_RECOVER 32
+#define TIO_BACKLOG_IDLE 0xFF  // Transport link is down, its refusals don't count
+
+// One slot update as handed to every transport. Signal slots w/ a codec also
+// carry the samples encoded once as blocks no longer than the smallest
+// transport payload; transports that can't send codec frames use the raw data.
+typedef struct {
+    uint8_t slot;
+    uint8_t slot_type;
+    const uint8_t *data; // Raw slot data
+    uint32_t length;
+    uint8_t codec;             // Block codec (TIO_CODEC_NONE - no blocks)
+    const uint8_t *blocks;     // Encoded blocks back to back
+    const uint16_t *block_lens;
+    uint32_t num_blocks;
+    uint8_t rate_div;          // Samples decimated by this (0 or 1 - full rate)
+} tio_slot_update_t;
+
+// Transport plugged into the core. Each transport keeps its own queueing and
+// drop policy; send returns 0 if it took the whole update.
+typedef struct {
+    uint32_t (*max_payload)(void); // Largest payload of one frame/notification
+    uint32_t (*send)(const tio_slot_update_t *update);
+    uint32_t (*send_uio)(const uint8_t *data, uint32_t length);
+    uint32_t (*backlog)(uint8_t slot); // Optional, signal queue fill in percent or TIO_BACKLOG_IDLE
+    bool (*rate_tag)(void);            // Optional, true if decimated samples go out tagged w/ rate_div
+} tio_transport_t;
+
+typedef struct {
+    const tio_transport_t *const *transports;
+    uint32_t num_transports;  // Max 32
+    uint8_t codec[TIO_SLOTS]; // Signal slot codec (TIO_CODEC_*), data is then int16 samples
+    pfnTickUs tick_us_cb;     // Optional, needed for max_latency_us
+    uint32_t max_latency_us[TIO_SLOTS]; // Accumulated samples wait at most this (0 - until full)
+    bool rate_control[TIO_SLOTS];       // Decimate int16 samples under backpressure
+    uint8_t rate_factors[TIO_RATE_STEPS]; // Decimation per step, ascending (0 - no further steps, all 0 - 2, 4, 8)
+} tio_context_t;
+
+// Accumulator counters, free-running since tio_init()
+typedef struct {
+    uint32_t frames;       // Buffers sent (incl. partially refused)
+    uint32_t bytes;        // Sample bytes in those buffers
+    uint32_t capacity;     // Bytes those buffers could have held (utilisation = bytes / capacity)
+    uint32_t partial_frames; // Buffers sent before they were full (deadline, flush or new sample size)
+    uint32_t retries;      // Sends of a buffer every transport had refused
+    uint32_t dropped;      // Buffers dropped after every transport refused them or lost the rate tag
+    uint8_t rate_div;      // Current decimation factor (1 - full rate)
+    uint32_t rate_downs;   // Steps down to a lower rate
+    uint32_t rate_ups;     // Steps back up
+} tio_acc_stats_t;
+
+// Bit per exposed type (1 << slot_type) of each slot, from TIO_SLOT_TABLE
+extern const uint8_t tioSlotTypes[TIO_SLOTS];
+
+/**
+ * @brief Check a slot exists and exposes a type
+ *
+ * @param slot Slot number
+ * @param slot_type Slot type (signal or metric)
+ * @return true if valid
+ */
+static inline bool
+tio_slot_valid(uint8_t slot, uint8_t slot_type)
+{
+    return slot < TIO_SLOTS && slot_type <= TIO_SLOT_METRIC && ((tioSlotTypes[slot] >> slot_type) & 1);
+}
+
+/**
+ * @brief Initialize the core w/ its transports
+ *
+ * @param ctx Tileio context
+ * @return uint32_t
+ */
+uint32_t
+tio_init(tio_context_t *ctx);
+
+/**
+ * @brief Encode slot data once and send it on every transport
+ *
+ * Called from one task at a time (encoded blocks use a shared buffer).
+ *
+ * @param slot Slot number
+ * @param slot_type Slot type (0 - signal, 1 - metric)
+ * @param data Slot data
+ * @param length Data length
+ * @return uint32_t Bit mask of transports that refused the update (0 - all sent)
+ */
+uint32_t
+tio_send_slot_data(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length);
+
+/**
+ * @brief Send UIO state on every transport
+ *
+ * @param data UIO state
+ * @param length State length
+ * @return uint32_t Bit mask of transports that refused the state (0 - all sent)
+ */
+uint32_t
+tio_send_uio_state(const uint8_t *data, uint32_t length);
+
+/**
+ * @brief Add samples to a signal slot's accumulator, sending every buffer
+ * that fills up (or whose oldest sample is due)
+ *
+ * Called from the task that calls tio_send_slot_data(). Changing sample_size
+ * sends what was accumulated first.
+ *
+ * @param slot Slot number
+ * @param samples Samples back to back
+ * @param n Number of samples
+ * @param sample_size Bytes per sample (2 for slots w/ a codec)
+ * @return uint32_t Bit mask of transports that refused a buffer (0 - all sent)
+ */
+uint32_t
+tio_slot_push_samples(uint8_t slot, const void *samples, uint32_t n, uint32_t sample_size);
+
+/**
+ * @brief Send due accumulator buffers and retry refused ones
+ *
+ * Call periodically (at least every max_latency_us) from the pushing task.
+ *
+ * @return uint32_t Bit mask of transports that refused a buffer (0 - all sent)
+ */
+uint32_t
+tio_slot_poll(void);
+
+/**
+ * @brief Send a slot's accumulated samples now
+ *
+ * @param slot Slot number
+ * @return uint32_t Bit mask of transports that refused the buffer (0 - all sent)
+ */
+uint32_t
+tio_slot_flush(uint8_t slot);
+
+/**
+ * @brief Get a slot's accumulator counters
+ *
+ * @param slot Slot number
+ * @param stats Counters
+ * @return uint32_t 0 on success, 1 if slot has no signal
+ */
+uint32_t
+tio_get_acc_stats(uint8_t slot, tio_acc_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __TIO_CORE_H
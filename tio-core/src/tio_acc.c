@@ -0,0 +1,275 @@
+/**
+ * @file tio_acc.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio per-slot sample accumulators w/ double buffers
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "tio_core_priv.h"
+
+typedef struct {
+    uint8_t *fill;       // Buffer being filled
+    uint8_t *pending;    // Other buffer if every transport refused it (NULL - free)
+    uint16_t fillLen;
+    uint16_t pendingLen;
+    uint16_t pendingCap; // Bytes the pending buffer could have held
+    uint8_t fillDiv;     // Decimation factor of the samples in each buffer
+    uint8_t pendingDiv;
+    uint8_t sampleSize;
+    uint32_t start;      // Tick of the oldest sample in fill
+} tio_acc_t;
+
+// Storage only for slots exposing a signal, indexed by tioSignalIdx
+static uint8_t tioAccBufs[TIO_CORE_ACC_SLOTS][2][TIO_CORE_ACC_LEN];
+static tio_acc_t tioAccs[TIO_CORE_ACC_SLOTS];
+static tio_acc_stats_t tioAccStats[TIO_CORE_ACC_SLOTS];
+static tio_context_t *tioAccCtx = NULL;
+
+/**
+ * @brief Get buffer fill that triggers a send: whole samples that fit every
+ * transport's payload
+ */
+static uint32_t
+tio_acc_target(uint32_t sampleSize)
+{
+    uint32_t len = tio_core_min_payload(TIO_CORE_ACC_LEN);
+    return len - len % sampleSize;
+}
+
+/**
+ * @brief Send a buffer, keeping it pending if every transport refused it
+ */
+static uint32_t
+tio_acc_send(uint8_t slot, uint8_t *buf, uint32_t len, uint32_t cap, uint8_t div)
+{
+    uint8_t idx = tioSignalIdx[slot];
+    tio_acc_t *acc = &tioAccs[idx];
+    tio_acc_stats_t *stats = &tioAccStats[idx];
+    if (div > 1 && !tio_core_rate_tag(slot))
+    {
+        // Decimated before a transport lost the rate tag, its host would
+        // take the samples for full rate ones
+        stats->dropped++;
+        return tio_core_all_transports();
+    }
+    uint32_t refused = tio_core_send(slot, TIO_SLOT_SIGNAL, buf, len, div);
+    // Only int16 samples are decimated
+    if (acc->sampleSize == sizeof(int16_t))
+    {
+        tio_rate_update(slot, refused, stats);
+    }
+    if (refused && refused == tio_core_all_transports())
+    {
+        acc->pending = buf;
+        acc->pendingLen = len;
+        acc->pendingCap = cap;
+        acc->pendingDiv = div;
+        return refused;
+    }
+    stats->frames++;
+    stats->bytes += len;
+    stats->capacity += cap;
+    stats->partial_frames += len < cap ? 1 : 0;
+    return refused;
+}
+
+/**
+ * @brief Send the pending buffer again
+ */
+static uint32_t
+tio_acc_retry(uint8_t slot)
+{
+    uint8_t idx = tioSignalIdx[slot];
+    tio_acc_t *acc = &tioAccs[idx];
+    uint8_t *buf = acc->pending;
+    if (buf == NULL)
+    {
+        return 0;
+    }
+    acc->pending = NULL;
+    tioAccStats[idx].retries++;
+    return tio_acc_send(slot, buf, acc->pendingLen, acc->pendingCap, acc->pendingDiv);
+}
+
+/**
+ * @brief Send the fill buffer and continue in the other one
+ */
+static uint32_t
+tio_acc_swap(uint8_t slot)
+{
+    uint8_t idx = tioSignalIdx[slot];
+    tio_acc_t *acc = &tioAccs[idx];
+    if (acc->fillLen == 0)
+    {
+        return 0;
+    }
+    uint32_t refused = tio_acc_retry(slot);
+    if (acc->pending != NULL)
+    {
+        // Still refused, the oldest samples make room
+        acc->pending = NULL;
+        tioAccStats[idx].dropped++;
+    }
+    uint8_t *full = acc->fill;
+    uint32_t len = acc->fillLen;
+    acc->fill = full == tioAccBufs[idx][0] ? tioAccBufs[idx][1] : tioAccBufs[idx][0];
+    acc->fillLen = 0;
+    return refused | tio_acc_send(slot, full, len, tio_acc_target(acc->sampleSize), acc->fillDiv);
+}
+
+/**
+ * @brief Check if the oldest sample in the fill buffer waited max_latency_us
+ */
+static bool
+tio_acc_due(uint8_t slot)
+{
+    tio_acc_t *acc = &tioAccs[tioSignalIdx[slot]];
+    uint32_t maxLatency = tioAccCtx->max_latency_us[slot];
+    return acc->fillLen && maxLatency && tioAccCtx->tick_us_cb && tioAccCtx->tick_us_cb() - acc->start >= maxLatency;
+}
+
+/**
+ * @brief Copy samples taken at one rate into the fill buffer, sending every
+ * buffer that fills up
+ */
+static uint32_t
+tio_acc_add(uint8_t slot, const uint8_t *src, uint32_t bytes, uint32_t target, uint8_t div)
+{
+    tio_acc_t *acc = &tioAccs[tioSignalIdx[slot]];
+    uint32_t refused = 0;
+    // A buffer holds one rate
+    if (acc->fillLen && acc->fillDiv != div)
+    {
+        refused |= tio_acc_swap(slot);
+    }
+    while (bytes)
+    {
+        if (acc->fillLen == 0)
+        {
+            acc->start = tioAccCtx->tick_us_cb ? tioAccCtx->tick_us_cb() : 0;
+            acc->fillDiv = div;
+        }
+        // Target may have shrunk below the fill (e.g. smaller BLE MTU)
+        uint32_t room = target > acc->fillLen ? target - acc->fillLen : 0;
+        uint32_t chunk = bytes < room ? bytes : room;
+        memcpy(acc->fill + acc->fillLen, src, chunk);
+        acc->fillLen += chunk;
+        src += chunk;
+        bytes -= chunk;
+        if (acc->fillLen + acc->sampleSize > target)
+        {
+            refused |= tio_acc_swap(slot);
+        }
+    }
+    return refused;
+}
+
+void
+tio_acc_init(tio_context_t *ctx)
+{
+    tioAccCtx = ctx;
+    for (uint8_t slot = 0; slot < TIO_SLOTS; slot++)
+    {
+        if (tio_slot_valid(slot, TIO_SLOT_SIGNAL))
+        {
+            tioAccs[tioSignalIdx[slot]] = (tio_acc_t){.fill = tioAccBufs[tioSignalIdx[slot]][0]};
+        }
+    }
+    memset(tioAccStats, 0, sizeof(tioAccStats));
+}
+
+uint32_t
+tio_slot_push_samples(uint8_t slot, const void *samples, uint32_t n, uint32_t sample_size)
+{
+    if (!tio_slot_valid(slot, TIO_SLOT_SIGNAL) || sample_size == 0 || sample_size > TIO_CORE_ACC_LEN)
+    {
+        return tio_core_all_transports();
+    }
+    tio_acc_t *acc = &tioAccs[tioSignalIdx[slot]];
+    uint32_t refused = 0;
+    if (acc->sampleSize != sample_size)
+    {
+        refused |= tio_acc_swap(slot);
+        acc->sampleSize = sample_size;
+    }
+    uint32_t target = tio_acc_target(sample_size);
+    if (target == 0)
+    {
+        return refused | tio_core_all_transports();
+    }
+    if (sample_size == sizeof(int16_t) && tioAccCtx->rate_control[slot])
+    {
+        // Blocks of up to TIO_RATE_BLOCK output samples, so the rate can
+        // change between them
+        const int16_t *in = (const int16_t *)samples;
+        while (n)
+        {
+            uint8_t div = tio_rate_div(slot);
+            uint32_t chunk = n < TIO_RATE_BLOCK * div ? n : TIO_RATE_BLOCK * div;
+            if (div > 1)
+            {
+                int16_t out[TIO_RATE_BLOCK + 1];
+                uint32_t produced = tio_rate_decimate(slot, in, chunk, out);
+                refused |= tio_acc_add(slot, (const uint8_t *)out, produced * sizeof(int16_t), target, div);
+            }
+            else
+            {
+                refused |= tio_acc_add(slot, (const uint8_t *)in, chunk * sizeof(int16_t), target, 1);
+            }
+            in += chunk;
+            n -= chunk;
+        }
+    }
+    else
+    {
+        refused |= tio_acc_add(slot, (const uint8_t *)samples, n * sample_size, target, 1);
+    }
+    if (tio_acc_due(slot))
+    {
+        refused |= tio_acc_swap(slot);
+    }
+    return refused;
+}
+
+uint32_t
+tio_slot_poll(void)
+{
+    uint32_t refused = 0;
+    for (uint8_t slot = 0; slot < TIO_SLOTS; slot++)
+    {
+        if (tio_slot_valid(slot, TIO_SLOT_SIGNAL))
+        {
+            // Sending the fill buffer retries the pending one first
+            refused |= tio_acc_due(slot) ? tio_acc_swap(slot) : tio_acc_retry(slot);
+        }
+    }
+    return refused;
+}
+
+uint32_t
+tio_slot_flush(uint8_t slot)
+{
+    if (!tio_slot_valid(slot, TIO_SLOT_SIGNAL))
+    {
+        return tio_core_all_transports();
+    }
+    return tioAccs[tioSignalIdx[slot]].fillLen ? tio_acc_swap(slot) : tio_acc_retry(slot);
+}
+
+uint32_t
+tio_get_acc_stats(uint8_t slot, tio_acc_stats_t *stats)
+{
+    if (!tio_slot_valid(slot, TIO_SLOT_SIGNAL))
+    {
+        return 1;
+    }
+    *stats = tioAccStats[tioSignalIdx[slot]];
+    stats->rate_div = tio_rate_div(slot);
+    return 0;
+}
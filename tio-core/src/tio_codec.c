@@ -0,0 +1,256 @@
+/**
+ * @file tio_codec.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio signal sample codecs
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "tio_codec.h"
+
+#define TIO_CODEC_MAX_COUNT 0xFFFF
+#define TIO_CODEC_BITPACK_HDR_LEN (TIO_CODEC_HDR_LEN + 3)
+
+static inline uint16_t
+tio_codec_zigzag(int16_t delta)
+{
+    return (uint16_t)(((uint16_t)delta << 1) ^ (uint16_t)(delta >> 15));
+}
+
+static inline int16_t
+tio_codec_unzigzag(uint16_t value)
+{
+    return (int16_t)((value >> 1) ^ -(value & 1));
+}
+
+static inline uint32_t
+tio_codec_bit_width(uint16_t value)
+{
+    uint32_t width = 0;
+    while (value)
+    {
+        width++;
+        value >>= 1;
+    }
+    return width;
+}
+
+static inline void
+tio_codec_put_hdr(uint8_t *dst, uint8_t codec, uint32_t count)
+{
+    dst[0] = codec;
+    dst[1] = count & 0xFF;
+    dst[2] = (count >> 8) & 0xFF;
+}
+
+/**
+ * @brief Delta + zigzag + LEB128 varint
+ */
+static uint32_t
+tio_codec_encode_varint(const int16_t *samples, uint32_t count, uint8_t *dst, uint32_t dstLen, uint32_t *encoded)
+{
+    uint32_t pos = TIO_CODEC_HDR_LEN;
+    uint32_t n = 0;
+    int16_t prev = 0;
+    for (; n < count; n++)
+    {
+        uint16_t value = tio_codec_zigzag((int16_t)(samples[n] - prev));
+        uint32_t len = value < 0x80 ? 1 : value < 0x4000 ? 2 : 3;
+        if (pos + len > dstLen)
+        {
+            break;
+        }
+        while (value >= 0x80)
+        {
+            dst[pos++] = (value & 0x7F) | 0x80;
+            value >>= 7;
+        }
+        dst[pos++] = value;
+        prev = samples[n];
+    }
+    tio_codec_put_hdr(dst, TIO_CODEC_DELTA_VARINT, n);
+    *encoded = n;
+    return pos;
+}
+
+/**
+ * @brief Delta + zigzag + fixed width bit packing
+ */
+static uint32_t
+tio_codec_encode_bitpack(const int16_t *samples, uint32_t count, uint8_t *dst, uint32_t dstLen, uint32_t *encoded)
+{
+    if (dstLen < TIO_CODEC_BITPACK_HDR_LEN)
+    {
+        *encoded = 0;
+        return 0;
+    }
+    // Grow the block while the widest delta so far still fits
+    uint32_t n = 1;
+    uint32_t width = 0;
+    uint32_t maxBits = (dstLen - TIO_CODEC_BITPACK_HDR_LEN) * 8;
+    for (; n < count; n++)
+    {
+        uint32_t w = tio_codec_bit_width(tio_codec_zigzag((int16_t)(samples[n] - samples[n - 1])));
+        w = w > width ? w : width;
+        if (n * w > maxBits)
+        {
+            break;
+        }
+        width = w;
+    }
+    uint8_t *body = dst + TIO_CODEC_BITPACK_HDR_LEN;
+    uint32_t acc = 0;
+    uint32_t bits = 0;
+    uint32_t pos = 0;
+    for (uint32_t i = 1; i < n; i++)
+    {
+        acc |= (uint32_t)tio_codec_zigzag((int16_t)(samples[i] - samples[i - 1])) << bits;
+        bits += width;
+        while (bits >= 8)
+        {
+            body[pos++] = acc & 0xFF;
+            acc >>= 8;
+            bits -= 8;
+        }
+    }
+    if (bits)
+    {
+        body[pos++] = acc & 0xFF;
+    }
+    tio_codec_put_hdr(dst, TIO_CODEC_DELTA_BITPACK, n);
+    dst[TIO_CODEC_HDR_LEN] = width;
+    dst[TIO_CODEC_HDR_LEN + 1] = samples[0] & 0xFF;
+    dst[TIO_CODEC_HDR_LEN + 2] = (samples[0] >> 8) & 0xFF;
+    *encoded = n;
+    return TIO_CODEC_BITPACK_HDR_LEN + pos;
+}
+
+uint32_t
+tio_codec_encode(uint8_t codec, const int16_t *samples, uint32_t count, uint8_t *dst, uint32_t dstLen, uint32_t *encoded)
+{
+    *encoded = 0;
+    if (count == 0 || dstLen <= TIO_CODEC_HDR_LEN)
+    {
+        return 0;
+    }
+    if (count > TIO_CODEC_MAX_COUNT)
+    {
+        count = TIO_CODEC_MAX_COUNT;
+    }
+    uint32_t len = 0;
+    switch (codec)
+    {
+    case TIO_CODEC_DELTA_VARINT:
+        len = tio_codec_encode_varint(samples, count, dst, dstLen, encoded);
+        break;
+    case TIO_CODEC_DELTA_BITPACK:
+        len = tio_codec_encode_bitpack(samples, count, dst, dstLen, encoded);
+        break;
+    default:
+        break;
+    }
+    return *encoded ? len : 0;
+}
+
+uint32_t
+tio_codec_max_blocks(uint8_t codec, uint32_t count, uint32_t dstLen)
+{
+    uint32_t perBlock = 0;
+    // Deltas of int16 samples zigzag to at most 16 bits, i.e. 3 byte varints
+    if (codec == TIO_CODEC_DELTA_VARINT && dstLen > TIO_CODEC_HDR_LEN)
+    {
+        perBlock = (dstLen - TIO_CODEC_HDR_LEN) / 3;
+    }
+    else if (codec == TIO_CODEC_DELTA_BITPACK && dstLen >= TIO_CODEC_BITPACK_HDR_LEN)
+    {
+        perBlock = (dstLen - TIO_CODEC_BITPACK_HDR_LEN) * 8 / 16;
+        perBlock = perBlock ? perBlock : 1;
+    }
+    if (perBlock == 0)
+    {
+        return 0;
+    }
+    perBlock = perBlock > TIO_CODEC_MAX_COUNT ? TIO_CODEC_MAX_COUNT : perBlock;
+    return (count + perBlock - 1) / perBlock;
+}
+
+uint32_t
+tio_codec_decode(const uint8_t *src, uint32_t srcLen, int16_t *samples, uint32_t maxCount, uint32_t *count)
+{
+    *count = 0;
+    if (srcLen < TIO_CODEC_HDR_LEN)
+    {
+        return 1;
+    }
+    uint32_t n = src[1] | (src[2] << 8);
+    if (n > maxCount)
+    {
+        return 1;
+    }
+    if (src[0] == TIO_CODEC_DELTA_VARINT)
+    {
+        uint32_t pos = TIO_CODEC_HDR_LEN;
+        int16_t prev = 0;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            uint32_t value = 0;
+            for (uint32_t shift = 0;; shift += 7)
+            {
+                if (pos >= srcLen || shift > 14)
+                {
+                    return 1;
+                }
+                uint8_t byte = src[pos++];
+                value |= (uint32_t)(byte & 0x7F) << shift;
+                if (!(byte & 0x80))
+                {
+                    break;
+                }
+            }
+            prev = (int16_t)(prev + tio_codec_unzigzag(value));
+            samples[i] = prev;
+        }
+    }
+    else if (src[0] == TIO_CODEC_DELTA_BITPACK)
+    {
+        if (srcLen < TIO_CODEC_BITPACK_HDR_LEN || src[TIO_CODEC_HDR_LEN] > 16)
+        {
+            return 1;
+        }
+        uint32_t width = src[TIO_CODEC_HDR_LEN];
+        if (n > 1 && (uint64_t)(n - 1) * width > (uint64_t)(srcLen - TIO_CODEC_BITPACK_HDR_LEN) * 8)
+        {
+            return 1;
+        }
+        const uint8_t *body = src + TIO_CODEC_BITPACK_HDR_LEN;
+        uint32_t mask = (1UL << width) - 1;
+        uint32_t acc = 0;
+        uint32_t bits = 0;
+        int16_t prev = (int16_t)(src[TIO_CODEC_HDR_LEN + 1] | (src[TIO_CODEC_HDR_LEN + 2] << 8));
+        if (n)
+        {
+            samples[0] = prev;
+        }
+        for (uint32_t i = 1; i < n; i++)
+        {
+            while (bits < width)
+            {
+                acc |= (uint32_t)(*body++) << bits;
+                bits += 8;
+            }
+            prev = (int16_t)(prev + tio_codec_unzigzag(acc & mask));
+            acc >>= width;
+            bits -= width;
+            samples[i] = prev;
+        }
+    }
+    else
+    {
+        return 1;
+    }
+    *count = n;
+    return 0;
+}
@@ -0,0 +1,187 @@
+/**
+ * @file tio_core.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio transport-agnostic slot model and fan-out
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <stddef.h>
+#include "tio_codec.h"
+#include "tio_core_priv.h"
+
+_Static_assert(TIO_SLOTS <= TIO_SLOT_MAX, "TIO_SLOT_TABLE has too many slots");
+
+const uint8_t tioSlotTypes[TIO_SLOTS] = {TIO_SLOT_TABLE(TIO_SLOT_TYPES_)};
+uint8_t tioSignalIdx[TIO_SLOTS];
+
+static tio_context_t *gTioCtx = NULL;
+
+static uint8_t tioBlockBuf[TIO_CORE_BLOCK_BUF_LEN];
+static uint16_t tioBlockLens[TIO_CORE_MAX_BLOCKS];
+
+/**
+ * @brief Encode samples into blocks of at most blockLen bytes
+ *
+ * @return uint32_t 0 on success, 1 if length is odd or the samples don't fit
+ *                  the block buffer
+ */
+static uint32_t
+tio_core_encode(tio_slot_update_t *update, uint32_t blockLen)
+{
+    const int16_t *samples = (const int16_t *)update->data;
+    uint32_t count = update->length / 2;
+    uint32_t pos = 0;
+    update->num_blocks = 0;
+    // Samples are int16, an odd byte would be silently dropped
+    if (update->length & 1)
+    {
+        return 1;
+    }
+    while (count)
+    {
+        uint32_t room = TIO_CORE_BLOCK_BUF_LEN - pos;
+        uint32_t encoded;
+        uint32_t len = tio_codec_encode(update->codec, samples, count, tioBlockBuf + pos,
+                                        room < blockLen ? room : blockLen, &encoded);
+        if (len == 0 || update->num_blocks == TIO_CORE_MAX_BLOCKS)
+        {
+            return 1;
+        }
+        tioBlockLens[update->num_blocks++] = len;
+        pos += len;
+        samples += encoded;
+        count -= encoded;
+    }
+    update->blocks = tioBlockBuf;
+    update->block_lens = tioBlockLens;
+    return 0;
+}
+
+uint32_t
+tio_core_all_transports(void)
+{
+    return gTioCtx->num_transports == 32 ? 0xFFFFFFFF : (1UL << gTioCtx->num_transports) - 1;
+}
+
+uint32_t
+tio_core_min_payload(uint32_t limit)
+{
+    for (uint32_t i = 0; i < gTioCtx->num_transports; i++)
+    {
+        uint32_t maxPayload = gTioCtx->transports[i]->max_payload();
+        limit = maxPayload < limit ? maxPayload : limit;
+    }
+    return limit;
+}
+
+uint32_t
+tio_init(tio_context_t *ctx)
+{
+    if (ctx->num_transports > 32)
+    {
+        return 1;
+    }
+    gTioCtx = ctx;
+    uint8_t sig = 0;
+    for (uint8_t slot = 0; slot < TIO_SLOTS; slot++)
+    {
+        tioSignalIdx[slot] = tio_slot_valid(slot, TIO_SLOT_SIGNAL) ? sig++ : 0;
+    }
+    tio_acc_init(ctx);
+    tio_rate_init(ctx);
+    return 0;
+}
+
+uint32_t
+tio_core_backlog(uint8_t slot, uint32_t refused)
+{
+    uint32_t worst = 0;
+    for (uint32_t i = 0; i < gTioCtx->num_transports; i++)
+    {
+        const tio_transport_t *t = gTioCtx->transports[i];
+        uint32_t backlog = t->backlog ? t->backlog(slot) : 0;
+        if (backlog == TIO_BACKLOG_IDLE)
+        {
+            continue;
+        }
+        backlog = (refused >> i) & 1 ? 100 : backlog;
+        worst = backlog > worst ? backlog : worst;
+    }
+    return worst;
+}
+
+bool
+tio_core_rate_tag(uint8_t slot)
+{
+    for (uint32_t i = 0; i < gTioCtx->num_transports; i++)
+    {
+        const tio_transport_t *t = gTioCtx->transports[i];
+        if (t->backlog && t->backlog(slot) == TIO_BACKLOG_IDLE)
+        {
+            continue;
+        }
+        if (!t->rate_tag || !t->rate_tag())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t
+tio_send_slot_data(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length)
+{
+    return tio_core_send(slot, slot_type, data, length, 1);
+}
+
+uint32_t
+tio_core_send(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length, uint8_t rateDiv)
+{
+    uint32_t all = tio_core_all_transports();
+    if (!tio_slot_valid(slot, slot_type))
+    {
+        return all;
+    }
+    tio_slot_update_t update = {
+        .slot = slot,
+        .slot_type = slot_type,
+        .data = data,
+        .length = length,
+        .codec = slot_type == TIO_SLOT_SIGNAL ? gTioCtx->codec[slot] : TIO_CODEC_NONE,
+        .rate_div = rateDiv};
+    if (update.codec != TIO_CODEC_NONE)
+    {
+        // Blocks must fit every transport's frame
+        if (tio_core_encode(&update, tio_core_min_payload(TIO_CORE_BLOCK_BUF_LEN)))
+        {
+            return all;
+        }
+    }
+    uint32_t refused = 0;
+    for (uint32_t i = 0; i < gTioCtx->num_transports; i++)
+    {
+        if (gTioCtx->transports[i]->send(&update))
+        {
+            refused |= 1UL << i;
+        }
+    }
+    return refused;
+}
+
+uint32_t
+tio_send_uio_state(const uint8_t *data, uint32_t length)
+{
+    uint32_t refused = 0;
+    for (uint32_t i = 0; i < gTioCtx->num_transports; i++)
+    {
+        if (gTioCtx->transports[i]->send_uio(data, length))
+        {
+            refused |= 1UL << i;
+        }
+    }
+    return refused;
+}
@@ -0,0 +1,151 @@
+/**
+ * @file tio_core_priv.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio core internals shared between fan-out and accumulators
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __TIO_CORE_PRIV_H
+#define __TIO_CORE_PRIV_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tio_core.h"
+
+#ifdef TIO_HOST_BUILD
+// Host build (e.g. the USB loopback in tio-usb/host): reference stand-in for
+// the CMSIS-DSP decimator (tio_rate.c)
+typedef int16_t q15_t;
+
+typedef struct {
+    uint8_t M;
+    uint16_t numTaps;
+    const q15_t *pCoeffs;
+    q15_t *pState;
+} arm_fir_decimate_instance_q15;
+
+int32_t
+arm_fir_decimate_init_q15(arm_fir_decimate_instance_q15 *S, uint16_t numTaps, uint8_t M, const q15_t *pCoeffs,
+                          q15_t *pState, uint32_t blockSize);
+void
+arm_fir_decimate_q15(const arm_fir_decimate_instance_q15 *S, const q15_t *pSrc, q15_t *pDst, uint32_t blockSize);
+#else
+#include "arm_math.h"
+#endif
+
+// Slot to storage index among slots exposing a signal (TIO_SLOT_TABLE)
+extern uint8_t tioSignalIdx[TIO_SLOTS];
+
+/**
+ * @brief Get bit mask of every transport (as returned when all refuse)
+ *
+ * @return uint32_t
+ */
+uint32_t
+tio_core_all_transports(void);
+
+/**
+ * @brief Get the largest payload every transport can take in one frame
+ *
+ * @param limit Upper bound
+ * @return uint32_t
+ */
+uint32_t
+tio_core_min_payload(uint32_t limit);
+
+/**
+ * @brief Encode (if needed) and send slot data on every transport
+ *
+ * @param slot Slot number
+ * @param slot_type Slot type
+ * @param data Slot data
+ * @param length Data length
+ * @param rateDiv Decimation factor of the samples (1 - full rate)
+ * @return uint32_t Bit mask of transports that refused the update
+ */
+uint32_t
+tio_core_send(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length, uint8_t rateDiv);
+
+/**
+ * @brief Get the fullest backlog of a slot over transports whose link is up,
+ * counting a refusal as full
+ *
+ * @param slot Slot number
+ * @param refused Bit mask of transports that refused the last update
+ * @return uint32_t Percent (0 if every link is down)
+ */
+uint32_t
+tio_core_backlog(uint8_t slot, uint32_t refused);
+
+/**
+ * @brief Check every transport whose link is up tags decimated samples w/
+ * their rate, so a slot may leave full rate
+ *
+ * @param slot Slot number
+ * @return true if decimated samples reach every host tagged
+ */
+bool
+tio_core_rate_tag(uint8_t slot);
+
+/**
+ * @brief Reset accumulators
+ *
+ * @param ctx Tileio context
+ */
+void
+tio_acc_init(tio_context_t *ctx);
+
+/**
+ * @brief Design decimation filters and reset rate controllers to full rate
+ *
+ * @param ctx Tileio context
+ */
+void
+tio_rate_init(tio_context_t *ctx);
+
+/**
+ * @brief Get a slot's decimation factor
+ *
+ * Drops the slot back to full rate once a transport can't tag the rate.
+ *
+ * @param slot Slot number
+ * @return uint8_t 1 - full rate
+ */
+uint8_t
+tio_rate_div(uint8_t slot);
+
+/**
+ * @brief Decimate int16 samples at the slot's current factor
+ *
+ * Samples that don't make up a whole output sample are kept for the next
+ * call.
+ *
+ * @param slot Slot number
+ * @param samples Input samples
+ * @param n Input samples (at most TIO_RATE_BLOCK * tio_rate_div())
+ * @param out Output samples (at least TIO_RATE_BLOCK + 1)
+ * @return uint32_t Output samples
+ */
+uint32_t
+tio_rate_decimate(uint8_t slot, const int16_t *samples, uint32_t n, int16_t *out);
+
+/**
+ * @brief Step a slot's rate after a buffer was sent
+ *
+ * @param slot Slot number
+ * @param refused Bit mask of transports that refused the buffer
+ * @param stats Accumulator counters to update
+ */
+void
+tio_rate_update(uint8_t slot, uint32_t refused, tio_acc_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __TIO_CORE_PRIV_H
@@ -0,0 +1,218 @@
+/**
+ * @file tio_rate.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio backpressure-driven decimation of signal slots
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+#include "tio_core_priv.h"
+
+#define TIO_RATE_PI 3.14159265f
+
+typedef struct {
+    arm_fir_decimate_instance_q15 fir;
+    uint8_t step;      // 0 - full rate
+    uint8_t congested; // Congested buffers since the last step or calm buffer
+    uint8_t calm;      // Calm buffers in a row
+    uint8_t carryLen;
+    q15_t carry[TIO_RATE_MAX_FACTOR]; // Inputs short of a whole output sample
+    q15_t state[TIO_RATE_TAPS + TIO_RATE_BLOCK * TIO_RATE_MAX_FACTOR - 1];
+} tio_rate_t;
+
+static const uint8_t tioRateDefaults[TIO_RATE_STEPS] = {2, 4, 8};
+
+// Storage only for slots exposing a signal, indexed by tioSignalIdx
+static tio_rate_t tioRates[TIO_CORE_ACC_SLOTS];
+static q15_t tioRateCoeffs[TIO_RATE_STEPS][TIO_RATE_TAPS];
+static uint8_t tioRateFactors[TIO_RATE_STEPS];
+static uint8_t tioRateSteps = 0;
+static tio_context_t *tioRateCtx = NULL;
+
+/**
+ * @brief Design a Hamming windowed-sinc low-pass w/ its cutoff at the
+ * decimated Nyquist rate and unity DC gain
+ */
+static void
+tio_rate_design(q15_t *coeffs, uint32_t factor)
+{
+    float h[TIO_RATE_TAPS];
+    float sum = 0.0f;
+    float fc = 0.5f / factor;
+    for (uint32_t k = 0; k < TIO_RATE_TAPS; k++)
+    {
+        float x = 2.0f * fc * (k - (TIO_RATE_TAPS - 1) / 2.0f);
+        float sinc = x == 0.0f ? 1.0f : sinf(TIO_RATE_PI * x) / (TIO_RATE_PI * x);
+        h[k] = sinc * (0.54f - 0.46f * cosf(2.0f * TIO_RATE_PI * k / (TIO_RATE_TAPS - 1)));
+        sum += h[k];
+    }
+    for (uint32_t k = 0; k < TIO_RATE_TAPS; k++)
+    {
+        coeffs[k] = (q15_t)lrintf(h[k] / sum * 32767.0f);
+    }
+}
+
+/**
+ * @brief Move a slot to a step, starting the filter over
+ */
+static void
+tio_rate_set(tio_rate_t *rate, uint8_t step)
+{
+    rate->step = step;
+    rate->congested = 0;
+    rate->calm = 0;
+    rate->carryLen = 0;
+    if (step)
+    {
+        uint8_t factor = tioRateFactors[step - 1];
+        arm_fir_decimate_init_q15(&rate->fir, TIO_RATE_TAPS, factor, tioRateCoeffs[step - 1], rate->state,
+                                  TIO_RATE_BLOCK * factor);
+    }
+}
+
+void
+tio_rate_init(tio_context_t *ctx)
+{
+    tioRateCtx = ctx;
+    const uint8_t *factors = ctx->rate_factors[0] ? ctx->rate_factors : tioRateDefaults;
+    uint8_t prev = 1;
+    tioRateSteps = 0;
+    // Ascending factors up to the first one that isn't
+    while (tioRateSteps < TIO_RATE_STEPS && factors[tioRateSteps] > prev &&
+           factors[tioRateSteps] <= TIO_RATE_MAX_FACTOR)
+    {
+        prev = factors[tioRateSteps];
+        tioRateFactors[tioRateSteps] = prev;
+        tio_rate_design(tioRateCoeffs[tioRateSteps], prev);
+        tioRateSteps++;
+    }
+    memset(tioRates, 0, sizeof(tioRates));
+}
+
+uint8_t
+tio_rate_div(uint8_t slot)
+{
+    if (!tio_slot_valid(slot, TIO_SLOT_SIGNAL) || !tioRateCtx->rate_control[slot])
+    {
+        return 1;
+    }
+    tio_rate_t *rate = &tioRates[tioSignalIdx[slot]];
+    if (rate->step && !tio_core_rate_tag(slot))
+    {
+        // A transport lost the rate tag, untagged samples would play back
+        // too slowly on its host
+        tio_rate_set(rate, 0);
+    }
+    return rate->step ? tioRateFactors[rate->step - 1] : 1;
+}
+
+uint32_t
+tio_rate_decimate(uint8_t slot, const int16_t *samples, uint32_t n, int16_t *out)
+{
+    tio_rate_t *rate = &tioRates[tioSignalIdx[slot]];
+    // The step tio_rate_div() just picked, out is sized for it
+    uint32_t factor = rate->step ? tioRateFactors[rate->step - 1] : 1;
+    uint32_t produced = 0;
+    if (rate->carryLen)
+    {
+        uint32_t take = factor - rate->carryLen;
+        take = take < n ? take : n;
+        memcpy(rate->carry + rate->carryLen, samples, take * sizeof(q15_t));
+        rate->carryLen += take;
+        samples += take;
+        n -= take;
+        if (rate->carryLen < factor)
+        {
+            return 0;
+        }
+        arm_fir_decimate_q15(&rate->fir, rate->carry, out, factor);
+        rate->carryLen = 0;
+        produced++;
+    }
+    // The decimator only takes whole output samples
+    uint32_t whole = n - n % factor;
+    if (whole)
+    {
+        arm_fir_decimate_q15(&rate->fir, (q15_t *)samples, out + produced, whole);
+        produced += whole / factor;
+    }
+    rate->carryLen = n - whole;
+    memcpy(rate->carry, samples + whole, rate->carryLen * sizeof(q15_t));
+    return produced;
+}
+
+void
+tio_rate_update(uint8_t slot, uint32_t refused, tio_acc_stats_t *stats)
+{
+    if (!tioRateCtx->rate_control[slot])
+    {
+        return;
+    }
+    tio_rate_t *rate = &tioRates[tioSignalIdx[slot]];
+    uint32_t backlog = tio_core_backlog(slot, refused);
+    if (backlog >= TIO_RATE_BACKLOG_HIGH)
+    {
+        rate->calm = 0;
+        if (++rate->congested >= TIO_RATE_HOLD && rate->step < tioRateSteps && tio_core_rate_tag(slot))
+        {
+            tio_rate_set(rate, rate->step + 1);
+            stats->rate_downs++;
+        }
+    }
+    else if (backlog <= TIO_RATE_BACKLOG_LOW)
+    {
+        rate->congested = 0;
+        if (++rate->calm >= TIO_RATE_RECOVER && rate->step)
+        {
+            tio_rate_set(rate, rate->step - 1);
+            stats->rate_ups++;
+        }
+    }
+    else
+    {
+        rate->calm = 0;
+    }
+    stats->rate_div = tio_rate_div(slot);
+}
+
+#ifdef TIO_HOST_BUILD
+int32_t
+arm_fir_decimate_init_q15(arm_fir_decimate_instance_q15 *S, uint16_t numTaps, uint8_t M, const q15_t *pCoeffs,
+                          q15_t *pState, uint32_t blockSize)
+{
+    if (blockSize % M)
+    {
+        return -1;
+    }
+    S->M = M;
+    S->numTaps = numTaps;
+    S->pCoeffs = pCoeffs;
+    S->pState = pState;
+    memset(pState, 0, (numTaps + blockSize - 1) * sizeof(q15_t));
+    return 0;
+}
+
+void
+arm_fir_decimate_q15(const arm_fir_decimate_instance_q15 *S, const q15_t *pSrc, q15_t *pDst, uint32_t blockSize)
+{
+    // State holds the last numTaps - 1 inputs followed by this block
+    q15_t *x = S->pState + S->numTaps - 1;
+    memcpy(x, pSrc, blockSize * sizeof(q15_t));
+    for (uint32_t i = S->M - 1; i < blockSize; i += S->M)
+    {
+        int64_t acc = 0;
+        for (uint32_t k = 0; k < S->numTaps; k++)
+        {
+            acc += (int32_t)S->pCoeffs[k] * x[(int32_t)i - (int32_t)k];
+        }
+        acc >>= 15;
+        *pDst++ = (q15_t)(acc > INT16_MAX ? INT16_MAX : acc < INT16_MIN ? INT16_MIN : acc);
+    }
+    memmove(S->pState, S->pState + blockSize, (S->numTaps - 1) * sizeof(q15_t));
+}
+#endif // TIO_HOST_BUILD
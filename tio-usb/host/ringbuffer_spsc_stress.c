@@ -0,0 +1,238 @@
+/**
+ * @file ringbuffer_spsc_stress.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief SPSC ring buffer producer/consumer stress test
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * A producer thread writes a numbered element stream w/ a random mix of
+ * ringbuffer_spsc_push() and reserve/commit (committing part of a grant at
+ * times), while a consumer thread reads it back w/ pop, peek + seek and
+ * segments + seek. Runs a few element sizes and ring sizes, small ones so
+ * both sides keep hitting the wrap and the full/empty edges. Prints one JSON
+ * object per ring and exits nonzero if an element was lost, repeated or
+ * reordered.
+ *
+ *   ./ringbuffer_spsc_stress [MB per ring]
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ringbuffer_spsc.h"
+
+#define STRESS_MAX_DLEN 64
+#define STRESS_MAX_CHUNK 64 // Elements per call
+
+typedef struct {
+    size_t dlen;
+    uint32_t size;
+} stress_ring_t;
+
+typedef struct {
+    rb_spsc_t rb;
+    uint32_t elements;
+    // Producer
+    uint32_t pushes;
+    uint32_t reserves;
+    uint32_t producerSpins;
+    // Consumer
+    uint32_t pops;
+    uint32_t peeks;
+    uint32_t segments;
+    uint32_t consumerSpins;
+    uint32_t errors;
+    uint32_t firstError; // Element index of the first mismatch
+} stress_run_t;
+
+static const stress_ring_t stressRings[] = {
+    {1, 64}, {1, 4096}, {4, 256}, {STRESS_MAX_DLEN, 8},
+};
+
+static uint8_t stressBuf[4096];
+
+static uint32_t
+stress_rand(uint32_t *rng)
+{
+    *rng ^= *rng << 13;
+    *rng ^= *rng >> 17;
+    *rng ^= *rng << 5;
+    return *rng;
+}
+
+/**
+ * @brief Byte k of element i
+ */
+static inline uint8_t
+stress_byte(uint32_t i, size_t k)
+{
+    uint32_t h = i * 2654435761U;
+    return (uint8_t)((h >> 24) ^ (h >> (8 * (k & 3))) ^ k);
+}
+
+static void
+stress_fill(uint8_t *dst, uint32_t first, size_t n, size_t dlen)
+{
+    for (size_t e = 0; e < n; e++)
+    {
+        for (size_t k = 0; k < dlen; k++)
+        {
+            *dst++ = stress_byte(first + (uint32_t)e, k);
+        }
+    }
+}
+
+static void
+stress_check(stress_run_t *run, const uint8_t *src, uint32_t first, size_t n)
+{
+    size_t dlen = run->rb.dlen;
+    for (size_t e = 0; e < n; e++)
+    {
+        for (size_t k = 0; k < dlen; k++)
+        {
+            if (*src++ != stress_byte(first + (uint32_t)e, k))
+            {
+                if (run->errors++ == 0)
+                {
+                    run->firstError = first + (uint32_t)e;
+                }
+                src += dlen - k - 1;
+                break;
+            }
+        }
+    }
+}
+
+static void *
+stress_producer(void *arg)
+{
+    stress_run_t *run = arg;
+    rb_spsc_t *rb = &run->rb;
+    uint8_t chunk[STRESS_MAX_CHUNK * STRESS_MAX_DLEN];
+    uint32_t rng = 0x9E3779B9;
+    uint32_t next = 0;
+    while (next < run->elements)
+    {
+        size_t want = 1 + stress_rand(&rng) % STRESS_MAX_CHUNK;
+        want = want < run->elements - next ? want : run->elements - next;
+        size_t n;
+        if (stress_rand(&rng) & 1)
+        {
+            stress_fill(chunk, next, want, rb->dlen);
+            n = ringbuffer_spsc_push(rb, chunk, want);
+            run->pushes++;
+        }
+        else
+        {
+            size_t granted = want;
+            uint8_t *dst = ringbuffer_spsc_reserve(rb, &granted);
+            // Part of the grant at times, as a short USB read would
+            n = granted && (stress_rand(&rng) & 3) == 0 ? stress_rand(&rng) % (granted + 1) : granted;
+            if (dst)
+            {
+                stress_fill(dst, next, n, rb->dlen);
+                ringbuffer_spsc_commit(rb, n);
+            }
+            run->reserves++;
+        }
+        if (n == 0)
+        {
+            // Let the other side run on a single core host
+            run->producerSpins++;
+            sched_yield();
+        }
+        next += (uint32_t)n;
+    }
+    return NULL;
+}
+
+static void *
+stress_consumer(void *arg)
+{
+    stress_run_t *run = arg;
+    rb_spsc_t *rb = &run->rb;
+    uint8_t chunk[STRESS_MAX_CHUNK * STRESS_MAX_DLEN];
+    uint32_t rng = 0x7F4A7C15;
+    uint32_t next = 0;
+    while (next < run->elements)
+    {
+        size_t want = 1 + stress_rand(&rng) % STRESS_MAX_CHUNK;
+        size_t n;
+        switch (stress_rand(&rng) % 3)
+        {
+        case 0:
+            n = ringbuffer_spsc_pop(rb, chunk, want);
+            stress_check(run, chunk, next, n);
+            run->pops++;
+            break;
+        case 1:
+            n = ringbuffer_spsc_peek(rb, chunk, want);
+            stress_check(run, chunk, next, n);
+            n = ringbuffer_spsc_seek(rb, n);
+            run->peeks++;
+            break;
+        default:
+        {
+            const void *seg0, *seg1;
+            size_t len0, len1;
+            size_t avail = ringbuffer_spsc_segments(rb, &seg0, &len0, &seg1, &len1);
+            n = avail < want ? avail : want;
+            size_t first = n < len0 ? n : len0;
+            stress_check(run, seg0, next, first);
+            stress_check(run, seg1, next + (uint32_t)first, n - first);
+            n = ringbuffer_spsc_seek(rb, n);
+            run->segments++;
+            break;
+        }
+        }
+        if (n == 0)
+        {
+            // Let the other side run on a single core host
+            run->consumerSpins++;
+            sched_yield();
+        }
+        next += (uint32_t)n;
+    }
+    return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+    uint32_t mb = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 8;
+    int rc = 0;
+    for (size_t r = 0; r < sizeof(stressRings) / sizeof(stressRings[0]); r++)
+    {
+        stress_run_t run;
+        memset(&run, 0, sizeof(run));
+        run.rb.buffer = stressBuf;
+        run.rb.dlen = stressRings[r].dlen;
+        run.rb.size = stressRings[r].size;
+        // Counters start near the wrap of the free-running indices
+        atomic_init(&run.rb.head, UINT32_MAX - 1000);
+        atomic_init(&run.rb.tail, UINT32_MAX - 1000);
+        run.elements = (uint32_t)(mb * 1024 * 1024 / run.rb.dlen);
+        pthread_t producer, consumer;
+        pthread_create(&consumer, NULL, stress_consumer, &run);
+        pthread_create(&producer, NULL, stress_producer, &run);
+        pthread_join(producer, NULL);
+        pthread_join(consumer, NULL);
+        size_t left = ringbuffer_spsc_len(&run.rb);
+        printf("{\"dlen\":%zu,\"size\":%u,\"elements\":%u,\"pushes\":%u,\"reserves\":%u,\"producer_spins\":%u,"
+               "\"pops\":%u,\"peeks\":%u,\"segments\":%u,\"consumer_spins\":%u,\"left\":%zu,\"errors\":%u}\n",
+               run.rb.dlen, run.rb.size, run.elements, run.pushes, run.reserves, run.producerSpins, run.pops,
+               run.peeks, run.segments, run.consumerSpins, left, run.errors);
+        if (run.errors || left)
+        {
+            fprintf(stderr, "dlen %zu size %u: %u bad elements (first %u), %zu left\n", run.rb.dlen, run.rb.size,
+                    run.errors, run.firstError, left);
+            rc = 1;
+        }
+    }
+    return rc;
+}
@@ -0,0 +1,264 @@
+/**
+ * @file tio_codec_check.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio signal codec round trip check and compression report
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * Round trips both codecs through tio_codec_encode() and tio_codec_decode():
+ * single samples, full-scale int16 steps whose deltas zigzag to 16 bits, and
+ * every block length around the header sizes up to a frame, checking the
+ * encoder never writes past dstLen and stays within tio_codec_max_blocks().
+ * Then encodes synthetic traces in frame sized blocks and prints one JSON
+ * object per codec and trace w/ the compression ratio. Exits nonzero on any
+ * mismatch.
+ *
+ *   ./tio_codec_check [samples per trace]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tio_codec.h"
+
+#define CHECK_BITPACK_HDR_LEN (TIO_CODEC_HDR_LEN + 3) // WIDTH, first sample
+#define CHECK_BLOCK_LEN 248                           // USB frame DATA
+#define CHECK_GUARD 16
+#define CHECK_GUARD_BYTE 0xA5
+#define CHECK_MAX_SAMPLES 65536
+#define CHECK_PI 3.14159265
+
+typedef enum {
+    TRACE_BIOSIGNAL = 0, // Slow sines + a little noise, 12 bit range
+    TRACE_STEPS,         // Flat w/ occasional jumps
+    TRACE_NOISE,         // Full-scale white noise
+    TRACE_KINDS
+} trace_kind_e;
+
+static const char *const traceNames[TRACE_KINDS] = {"biosignal", "steps", "noise"};
+static const uint8_t checkCodecs[] = {TIO_CODEC_DELTA_VARINT, TIO_CODEC_DELTA_BITPACK};
+static const char *const codecNames[] = {"none", "delta_varint", "delta_bitpack"};
+
+static uint32_t checkRng = 1;
+static uint32_t checkFailures = 0;
+static int16_t checkIn[CHECK_MAX_SAMPLES];
+static int16_t checkOut[CHECK_MAX_SAMPLES];
+
+/**
+ * @brief Deterministic xorshift32 so every run sees the same cases
+ */
+static uint32_t
+check_rand(void)
+{
+    checkRng ^= checkRng << 13;
+    checkRng ^= checkRng >> 17;
+    checkRng ^= checkRng << 5;
+    return checkRng;
+}
+
+static void
+check_fail(const char *what, uint8_t codec, uint32_t count, uint32_t dstLen)
+{
+    if (checkFailures++ < 10)
+    {
+        fprintf(stderr, "%s: %s, count %u, dstLen %u\n", codecNames[codec], what, count, dstLen);
+    }
+}
+
+/**
+ * @brief Bytes the first sample needs on its own
+ */
+static uint32_t
+check_min_len(uint8_t codec, int16_t first)
+{
+    if (codec == TIO_CODEC_DELTA_BITPACK)
+    {
+        return CHECK_BITPACK_HDR_LEN;
+    }
+    uint16_t zz = (uint16_t)(((uint16_t)first << 1) ^ (uint16_t)(first >> 15));
+    return TIO_CODEC_HDR_LEN + (zz < 0x80 ? 1 : zz < 0x4000 ? 2 : 3);
+}
+
+/**
+ * @brief Encode samples into blocks of dstLen bytes and decode each back
+ *
+ * @return uint32_t Encoded bytes
+ */
+static uint32_t
+check_round_trip(uint8_t codec, const int16_t *samples, uint32_t count, uint32_t dstLen)
+{
+    uint8_t block[CHECK_BLOCK_LEN + CHECK_GUARD];
+    uint32_t blocks = 0;
+    uint32_t bytes = 0;
+    uint32_t done = 0;
+    while (done < count)
+    {
+        uint32_t encoded;
+        memset(block, CHECK_GUARD_BYTE, sizeof(block));
+        uint32_t len = tio_codec_encode(codec, samples + done, count - done, block, dstLen, &encoded);
+        for (uint32_t i = dstLen; i < sizeof(block); i++)
+        {
+            if (block[i] != CHECK_GUARD_BYTE)
+            {
+                check_fail("wrote past dstLen", codec, count - done, dstLen);
+                break;
+            }
+        }
+        if (len == 0 || encoded == 0)
+        {
+            // Only when not even the next sample fits
+            if (len || encoded || dstLen >= check_min_len(codec, samples[done]))
+            {
+                check_fail("refused a block that fits", codec, count - done, dstLen);
+            }
+            return bytes;
+        }
+        if (len > dstLen || encoded > count - done)
+        {
+            check_fail("block larger than asked for", codec, count - done, dstLen);
+            return bytes;
+        }
+        uint32_t decoded;
+        if (tio_codec_decode(block, len, checkOut, CHECK_MAX_SAMPLES, &decoded) || decoded != encoded ||
+            memcmp(checkOut, samples + done, encoded * sizeof(int16_t)))
+        {
+            check_fail("round trip mismatch", codec, count - done, dstLen);
+            return bytes;
+        }
+        if (encoded > 1 && tio_codec_decode(block, len, checkOut, encoded - 1, &decoded) == 0)
+        {
+            check_fail("decoded into a short buffer", codec, count - done, dstLen);
+        }
+        done += encoded;
+        bytes += len;
+        blocks++;
+    }
+    // 0 - a worst case sample wouldn't fit, no bound to hold
+    uint32_t maxBlocks = tio_codec_max_blocks(codec, count, dstLen);
+    if (maxBlocks && blocks > maxBlocks)
+    {
+        check_fail("more blocks than tio_codec_max_blocks()", codec, count, dstLen);
+    }
+    return bytes;
+}
+
+/**
+ * @brief Single samples at the edges of the int16 range, in the smallest block
+ */
+static void
+check_single(uint8_t codec)
+{
+    static const int16_t values[] = {0, 1, -1, 63, -64, 64, 8191, -8192, 8192, INT16_MAX, INT16_MIN};
+    for (uint32_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+    {
+        uint32_t minLen = check_min_len(codec, values[i]);
+        if (check_round_trip(codec, &values[i], 1, minLen) != minLen)
+        {
+            check_fail("single sample in the smallest block", codec, 1, minLen);
+        }
+        check_round_trip(codec, &values[i], 1, minLen - 1);
+    }
+}
+
+/**
+ * @brief Full-scale steps, deltas whose zigzag takes all 16 bits
+ */
+static void
+check_full_scale(uint8_t codec)
+{
+    static const int16_t edges[] = {0, INT16_MIN, 0, INT16_MAX, INT16_MIN, INT16_MAX, -1, INT16_MAX, INT16_MIN, 1};
+    uint8_t block[CHECK_BLOCK_LEN];
+    uint32_t n = sizeof(edges) / sizeof(edges[0]);
+    for (uint32_t dstLen = 0; dstLen <= 64; dstLen++)
+    {
+        check_round_trip(codec, edges, n, dstLen);
+    }
+    for (uint32_t i = 0; i < 4096; i++)
+    {
+        checkIn[i] = (int16_t)((i & 1 ? 1 : -1) * (int32_t)(16384 + check_rand() % 16384));
+    }
+    check_round_trip(codec, checkIn, 4096, CHECK_BLOCK_LEN);
+    uint32_t encoded;
+    if (codec == TIO_CODEC_DELTA_BITPACK && tio_codec_encode(codec, edges, n, block, sizeof(block), &encoded) &&
+        block[TIO_CODEC_HDR_LEN] != 16)
+    {
+        check_fail("full-scale steps not packed 16 bits wide", codec, n, sizeof(block));
+    }
+}
+
+/**
+ * @brief Every block length from nothing up to a frame, around both header sizes
+ */
+static void
+check_lengths(uint8_t codec)
+{
+    for (uint32_t i = 0; i < 512; i++)
+    {
+        checkIn[i] = (int16_t)(check_rand() % 2048 - 1024);
+    }
+    for (uint32_t dstLen = 0; dstLen <= CHECK_BLOCK_LEN; dstLen++)
+    {
+        check_round_trip(codec, checkIn, 512, dstLen);
+        check_round_trip(codec, checkIn, 1, dstLen);
+        check_round_trip(codec, checkIn, 2, dstLen);
+    }
+}
+
+static void
+check_trace(trace_kind_e kind, uint32_t count)
+{
+    double phase = 0.0;
+    int16_t level = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        switch (kind)
+        {
+        case TRACE_BIOSIGNAL:
+            phase += 2.0 * CHECK_PI * 1.2 / 250.0;
+            checkIn[i] = (int16_t)(1200.0 * sin(phase) + 400.0 * sin(7.0 * phase) + (int32_t)(check_rand() % 17) - 8);
+            break;
+        case TRACE_STEPS:
+            level = check_rand() % 64 == 0 ? (int16_t)check_rand() : level;
+            checkIn[i] = level;
+            break;
+        default:
+            checkIn[i] = (int16_t)check_rand();
+            break;
+        }
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    uint32_t count = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 16384;
+    count = count < CHECK_MAX_SAMPLES ? count : CHECK_MAX_SAMPLES;
+    for (uint32_t c = 0; c < sizeof(checkCodecs); c++)
+    {
+        check_single(checkCodecs[c]);
+        check_full_scale(checkCodecs[c]);
+        check_lengths(checkCodecs[c]);
+    }
+    for (uint32_t kind = 0; kind < TRACE_KINDS; kind++)
+    {
+        for (uint32_t c = 0; c < sizeof(checkCodecs); c++)
+        {
+            checkRng = 1 + kind;
+            check_trace((trace_kind_e)kind, count);
+            uint32_t bytes = check_round_trip(checkCodecs[c], checkIn, count, CHECK_BLOCK_LEN);
+            printf("{\"codec\":\"%s\",\"trace\":\"%s\",\"samples\":%u,\"block_len\":%u,\"bytes\":%u,"
+                   "\"bits_per_sample\":%.2f,\"ratio\":%.2f}\n",
+                   codecNames[checkCodecs[c]], traceNames[kind], count, CHECK_BLOCK_LEN, bytes,
+                   bytes ? 8.0 * bytes / count : 0.0, bytes ? 2.0 * count / bytes : 0.0);
+        }
+    }
+    if (checkFailures)
+    {
+        fprintf(stderr, "%u codec checks failed\n", checkFailures);
+    }
+    return checkFailures ? 1 : 0;
+}
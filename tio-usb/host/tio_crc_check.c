@@ -0,0 +1,123 @@
+/**
+ * @file tio_crc_check.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio CRC engines checked against the bit-serial definition
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * Built once per TIO_CRC_IMPL value w/ tio_crc.c. Runs tio_crc16(),
+ * tio_crc16_update(), tio_crc16_copy() and tio_crc32_update() over random
+ * lengths, buffer offsets and split points against bit-serial reference
+ * loops and prints one JSON object. Exits nonzero on any mismatch.
+ *
+ *   ./tio_crc_check_<impl> [cases]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tio_crc.h"
+
+#define CHECK_MAX_LEN 1024
+#define CHECK_MAX_OFFSET 8
+
+static uint32_t checkRng = 1;
+static uint8_t checkSrc[CHECK_MAX_LEN + CHECK_MAX_OFFSET];
+static uint8_t checkDst[CHECK_MAX_LEN + CHECK_MAX_OFFSET];
+
+/**
+ * @brief Deterministic xorshift32 so every run sees the same cases
+ */
+static uint32_t
+check_rand(void)
+{
+    checkRng ^= checkRng << 13;
+    checkRng ^= checkRng >> 17;
+    checkRng ^= checkRng << 5;
+    return checkRng;
+}
+
+static uint16_t
+check_crc16_ref(uint16_t crc, const uint8_t *data, uint32_t length)
+{
+    for (uint32_t j = 0; j < length; j++)
+    {
+        crc ^= (uint16_t)(data[j] << 8);
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static uint32_t
+check_crc32_ref(uint32_t crc, const uint8_t *data, uint32_t length)
+{
+    crc = ~crc;
+    for (uint32_t j = 0; j < length; j++)
+    {
+        crc ^= data[j];
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320U : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+/**
+ * @brief Check one buffer whole and split in two at a random point
+ *
+ * @return uint32_t Mismatches
+ */
+static uint32_t
+check_case(const uint8_t *data, uint32_t length, uint8_t *dst)
+{
+    uint32_t split = length ? check_rand() % (length + 1) : 0;
+    uint16_t want16 = check_crc16_ref(TIO_CRC16_SEED, data, length);
+    uint32_t want32 = check_crc32_ref(TIO_CRC32_SEED, data, length);
+    uint32_t bad = 0;
+    bad += tio_crc16(data, length) != want16;
+    bad += tio_crc16_update(tio_crc16_update(TIO_CRC16_SEED, data, split), data + split, length - split) != want16;
+    bad += tio_crc32_update(tio_crc32_update(TIO_CRC32_SEED, data, split), data + split, length - split) != want32;
+    memset(dst, 0, length);
+    uint16_t crc = tio_crc16_copy(TIO_CRC16_SEED, dst, data, split);
+    crc = tio_crc16_copy(crc, dst + split, data + split, length - split);
+    bad += crc != want16;
+    bad += memcmp(dst, data, length) != 0;
+    return bad;
+}
+
+int
+main(int argc, char **argv)
+{
+    uint32_t cases = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 20000;
+    uint32_t bad = 0;
+    uint32_t bytes = 0;
+    // CRC-32 check value, "123456789" -> 0xCBF43926
+    bad += tio_crc32_update(TIO_CRC32_SEED, (const uint8_t *)"123456789", 9) != 0xCBF43926U;
+    for (uint32_t i = 0; i < sizeof(checkSrc); i++)
+    {
+        checkSrc[i] = check_rand();
+    }
+    // Every length up to a few table strides, then random ones
+    for (uint32_t len = 0; len <= 4 * 8 + 3; len++)
+    {
+        bad += check_case(checkSrc, len, checkDst);
+        bytes += len;
+    }
+    for (uint32_t i = 0; i < cases; i++)
+    {
+        uint32_t len = check_rand() % (CHECK_MAX_LEN + 1);
+        uint32_t srcOff = check_rand() % CHECK_MAX_OFFSET;
+        uint32_t dstOff = check_rand() % CHECK_MAX_OFFSET;
+        bad += check_case(checkSrc + srcOff, len, checkDst + dstOff);
+        bytes += len;
+    }
+    printf("{\"impl\":%u,\"cases\":%u,\"bytes\":%u,\"mismatches\":%u}\n", TIO_CRC_IMPL, cases, bytes, bad);
+    return bad ? 1 : 0;
+}
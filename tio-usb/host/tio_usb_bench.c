@@ -0,0 +1,359 @@
+/**
+ * @file tio_usb_bench.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio USB host loopback benchmark scenarios
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * Runs fixed scenarios through the loopback build and prints one JSON object
+ * per scenario on stdout. Exits nonzero if a lossless scenario lost frames.
+ *
+ *   ./tio_usb_bench [scale]   (scale multiplies message counts, default 1)
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tio_usb.h"
+
+#define BENCH_STACK_LEN (256 * 1024)
+#define BENCH_STACK_FILL 0xA5
+#define BENCH_PUMP_EVERY 8
+
+typedef struct {
+    const char *name;
+    void (*run)(uint32_t scale);
+    bool lossless; // Every message sent must be delivered
+} bench_scenario_t;
+
+typedef struct {
+    uint32_t messages; // Slot messages and UIO states sent
+    uint32_t refused;  // Sends the library refused
+    uint32_t delivered;
+    uint64_t delivered_bytes;
+} bench_count_t;
+
+static tio_usb_context_t benchCtx;
+static bench_count_t benchCount;
+static uint32_t benchRng = 1;
+
+static uint32_t
+bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+static uint32_t
+bench_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+static double
+bench_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Deterministic xorshift32 so runs are comparable
+ */
+static uint32_t
+bench_rand(void)
+{
+    benchRng ^= benchRng << 13;
+    benchRng ^= benchRng >> 17;
+    benchRng ^= benchRng << 5;
+    return benchRng;
+}
+
+static void
+bench_slot_cb(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length)
+{
+    (void)slot;
+    (void)slot_type;
+    (void)data;
+    benchCount.delivered++;
+    benchCount.delivered_bytes += length;
+}
+
+static void
+bench_uio_cb(const uint8_t *data, uint32_t length)
+{
+    (void)data;
+    benchCount.delivered++;
+    benchCount.delivered_bytes += length;
+}
+
+/**
+ * @brief Flip one bit in half the transfers
+ */
+static uint32_t
+bench_corrupt_tap(uint8_t *buffer, uint32_t length)
+{
+    if (length && (bench_rand() & 1))
+    {
+        buffer[bench_rand() % length] ^= 1 << (bench_rand() & 7);
+    }
+    return length;
+}
+
+/**
+ * @brief Send everything staged and loop it back through the receive path
+ */
+static void
+bench_pump(void)
+{
+    tio_usb_flush();
+    tio_usb_loopback_poll();
+}
+
+/**
+ * @brief Start from a fresh link and negotiate caps w/ a HELLO
+ */
+static void
+bench_setup(uint16_t caps, tio_usb_batch_config_t batch, pfnLoopbackTap tap)
+{
+    tio_usb_loopback_config_t loop = {.tap = tap};
+    memset(&benchCtx, 0, sizeof(benchCtx));
+    benchRng = 1;
+    benchCtx.slot_update_cb = bench_slot_cb;
+    benchCtx.uio_update_cb = bench_uio_cb;
+    benchCtx.tick_us_cb = bench_now_us;
+    benchCtx.cycles_cb = bench_now_ns;
+    benchCtx.batch = batch;
+    tio_usb_loopback_config(&loop);
+    tio_usb_init(&benchCtx);
+    if (caps)
+    {
+        uint8_t hello[4] = {0x01, TIO_USB_PROTOCOL_VERSION, caps & 0xFF, caps >> 8};
+        uint8_t packet[TIO_USB_PACKET_LEN];
+        tio_usb_pack_slot_data(0, 3, hello, sizeof(hello), packet);
+        tio_usb_loopback_inject(packet, TIO_USB_PACKET_LEN);
+        bench_pump();
+    }
+    // HELLO and its reply aren't scenario messages
+    memset(&benchCount, 0, sizeof(benchCount));
+}
+
+static void
+bench_send(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length)
+{
+    benchCount.messages++;
+    if (tio_usb_send_slot_data(slot, slot_type, data, length))
+    {
+        // Endpoint full, drain and retry once
+        bench_pump();
+        if (tio_usb_send_slot_data(slot, slot_type, data, length))
+        {
+            benchCount.refused++;
+        }
+    }
+    if (benchCount.messages % BENCH_PUMP_EVERY == 0)
+    {
+        bench_pump();
+    }
+}
+
+/**
+ * @brief Full 248 byte signal frames on 4 slots, coalesced
+ */
+static void
+bench_signal_saturation(uint32_t scale)
+{
+    static uint8_t data[248];
+    tio_usb_batch_config_t batch = TIO_USB_BATCH_THROUGHPUT;
+    bench_setup(TIO_USB_CAP_COMPACT | TIO_USB_CAP_SEQ | TIO_USB_CAP_TIMESTAMP, batch, NULL);
+    for (uint32_t i = 0; i < sizeof(data); i++)
+    {
+        data[i] = bench_rand();
+    }
+    for (uint32_t i = 0; i < 20000 * scale; i++)
+    {
+        bench_send(i % 4, 0, data, sizeof(data));
+    }
+    bench_pump();
+}
+
+/**
+ * @brief Metric messages from 16 bytes up to fragmented 600 byte messages
+ */
+static void
+bench_metric_heavy(uint32_t scale)
+{
+    static const uint32_t lens[] = {16, 64, 200, 600};
+    static uint8_t data[600];
+    tio_usb_batch_config_t batch = TIO_USB_BATCH_LOW_LATENCY;
+    bench_setup(TIO_USB_CAP_COMPACT | TIO_USB_CAP_SEQ | TIO_USB_CAP_FRAGMENT, batch, NULL);
+    for (uint32_t i = 0; i < sizeof(data); i++)
+    {
+        data[i] = bench_rand();
+    }
+    for (uint32_t i = 0; i < 5000 * scale; i++)
+    {
+        bench_send(i % 4, 1, data, lens[i % 4]);
+    }
+    bench_pump();
+}
+
+/**
+ * @brief Bursts of 32 UIO states between pumps
+ */
+static void
+bench_uio_bursts(uint32_t scale)
+{
+    uint8_t state[8] = {0};
+    tio_usb_batch_config_t batch = TIO_USB_BATCH_THROUGHPUT;
+    bench_setup(TIO_USB_CAP_COMPACT, batch, NULL);
+    for (uint32_t i = 0; i < 20000 * scale; i++)
+    {
+        state[i % 8]++;
+        benchCount.messages++;
+        if (tio_usb_send_uio_state(state, sizeof(state)))
+        {
+            benchCount.refused++;
+        }
+        if (i % 32 == 31)
+        {
+            bench_pump();
+        }
+    }
+    bench_pump();
+}
+
+/**
+ * @brief Signal and metric frames w/ a bit flipped in half the transfers
+ */
+static void
+bench_corrupted_resync(uint32_t scale)
+{
+    static uint8_t data[248];
+    tio_usb_batch_config_t batch = TIO_USB_BATCH_LOW_LATENCY;
+    bench_setup(TIO_USB_CAP_COMPACT | TIO_USB_CAP_SEQ, batch, bench_corrupt_tap);
+    for (uint32_t i = 0; i < sizeof(data); i++)
+    {
+        data[i] = bench_rand();
+    }
+    for (uint32_t i = 0; i < 10000 * scale; i++)
+    {
+        bench_send(i % 4, i & 1, data, 8 + bench_rand() % (sizeof(data) - 8));
+    }
+    bench_pump();
+}
+
+static const bench_scenario_t benchScenarios[] = {
+    {"signal_saturation", bench_signal_saturation, true},
+    {"metric_heavy", bench_metric_heavy, true},
+    {"uio_bursts", bench_uio_bursts, true},
+    {"corrupted_resync", bench_corrupted_resync, false},
+};
+
+typedef struct {
+    const bench_scenario_t *scenario;
+    uint32_t scale;
+    double seconds;
+} bench_run_t;
+
+static void *
+bench_thread(void *arg)
+{
+    bench_run_t *run = (bench_run_t *)arg;
+    double start = bench_seconds();
+    if (run->scenario)
+    {
+        run->scenario->run(run->scale);
+    }
+    run->seconds = bench_seconds() - start;
+    return NULL;
+}
+
+/**
+ * @brief Run a scenario on a painted stack
+ *
+ * @return size_t Stack bytes touched
+ */
+static size_t
+bench_run(bench_run_t *run)
+{
+    static uint8_t stack[BENCH_STACK_LEN] __attribute__((aligned(64)));
+    pthread_attr_t attr;
+    pthread_t thread;
+    memset(stack, BENCH_STACK_FILL, sizeof(stack));
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, sizeof(stack));
+    if (pthread_create(&thread, &attr, bench_thread, run))
+    {
+        fprintf(stderr, "pthread_create failed\n");
+        exit(2);
+    }
+    pthread_join(thread, NULL);
+    pthread_attr_destroy(&attr);
+    // Stack grows down from the top of the buffer
+    size_t untouched = 0;
+    while (untouched < sizeof(stack) && stack[untouched] == BENCH_STACK_FILL)
+    {
+        untouched++;
+    }
+    return sizeof(stack) - untouched;
+}
+
+static double
+bench_per(uint64_t num, uint32_t den)
+{
+    return den ? (double)num / den : 0.0;
+}
+
+int
+main(int argc, char **argv)
+{
+    uint32_t scale = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 1;
+    int rc = 0;
+    scale = scale ? scale : 1;
+    // Thread start-up itself, subtracted from each scenario
+    bench_run_t idle = {.scenario = NULL};
+    size_t stackBase = bench_run(&idle);
+    for (size_t i = 0; i < sizeof(benchScenarios) / sizeof(benchScenarios[0]); i++)
+    {
+        bench_run_t run = {.scenario = &benchScenarios[i], .scale = scale};
+        size_t stack = bench_run(&run);
+        tio_usb_perf_t perf;
+        tio_usb_stats_t stats;
+        tio_usb_tx_stats_t txStats;
+        tio_usb_loopback_stats_t loop;
+        tio_usb_get_perf(&perf);
+        tio_usb_get_stats(&stats);
+        tio_usb_get_tx_stats(&txStats);
+        tio_usb_loopback_get_stats(&loop);
+        bool lost = benchCount.delivered + benchCount.refused != benchCount.messages;
+        printf("{\"scenario\":\"%s\",\"messages\":%u,\"refused\":%u,\"delivered\":%u,"
+               "\"tx_frames\":%u,\"rx_frames\":%u,\"transfers\":%u,\"tx_bytes\":%u,\"seconds\":%.6f,"
+               "\"frames_per_s\":%.0f,\"bytes_per_s\":%.0f,\"pack_ns_per_frame\":%.1f,\"parse_ns_per_frame\":%.1f,"
+               "\"parse_max_ns\":%u,\"crc_errors\":%u,\"framing_errors\":%u,\"resync_bytes\":%u,\"seq_gaps\":%u,"
+               "\"rx_ring_max\":%u,\"stage_max\":%u,\"lane_max_depth\":[%u,%u],\"stack_bytes\":%zu}\n",
+               benchScenarios[i].name, benchCount.messages, benchCount.refused, benchCount.delivered,
+               stats.tx_frames, stats.rx_frames, loop.transfers, loop.tx_bytes, run.seconds,
+               bench_per(stats.rx_frames, 1) / run.seconds, bench_per(loop.tx_bytes, 1) / run.seconds,
+               bench_per(perf.pack_cycles, perf.pack_frames), bench_per(perf.parse_cycles, perf.parse_frames),
+               perf.parse_max_cycles, stats.crc_errors, stats.framing_errors, stats.resync_bytes, stats.seq_gaps,
+               perf.rx_ring_max, txStats.stage_max, txStats.lanes[0].max_depth, txStats.lanes[1].max_depth,
+               stack > stackBase ? stack - stackBase : 0);
+        if (benchScenarios[i].lossless && (lost || benchCount.refused))
+        {
+            fprintf(stderr, "%s: %u of %u messages lost\n", benchScenarios[i].name,
+                    benchCount.messages - benchCount.delivered, benchCount.messages);
+            rc = 1;
+        }
+    }
+    return rc;
+}
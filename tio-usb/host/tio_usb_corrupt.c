@@ -0,0 +1,318 @@
+/**
+ * @file tio_usb_corrupt.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio USB RX parser corruption-injection benchmark
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * Packs a deterministic stream of compact frames, corrupts a share of them
+ * w/ one kind of damage and feeds the stream through the USB receive
+ * callback in bulk packet sized chunks, each parsed by tio_usb_service()
+ * (deferred mode) or by the receive callback itself (inline mode, w/
+ * tio_usb_service() finishing passes cut short by rx_crc_budget). Prints
+ * one JSON object per mode and kind w/ frames recovered and lost, CRC work
+ * and the worst CPU time per input byte of any chunk. Exits nonzero if that
+ * exceeds the given budget, a clean stream loses frames, repeated frames
+ * show up as sequence gaps or frames stay parked behind rx_crc_budget once
+ * the host stops sending.
+ *
+ *   ./tio_usb_corrupt [frames] [budget ns/byte] [rx_crc_budget]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tio_usb.h"
+
+#define CORRUPT_CHUNK_LEN 64
+#define CORRUPT_RATE_PCT 20    // Frames damaged
+#define CORRUPT_MAX_INSERT 16  // Garbage bytes per insertion
+#define CORRUPT_MAX_DROP 8     // Bytes dropped per frame
+#define CORRUPT_STORM_PAIRS 64 // Fake frames per storm
+#define CORRUPT_TAIL_FRAMES 8  // Frames in the last receive of the tail check
+
+// Fake compact frame header whose stop byte lands on the 0xAA of a later
+// pair: each one passes the cheap checks and costs a 244 byte CRC
+#define CORRUPT_PAIR_LEN 5
+static const uint8_t corruptPair[CORRUPT_PAIR_LEN] = {0x55, 0x00, 0x80, 0xF2, 0xAA};
+
+typedef enum {
+    CORRUPT_NONE = 0,
+    CORRUPT_BIT_FLIP,
+    CORRUPT_DROP,
+    CORRUPT_INSERT,
+    CORRUPT_FAKE_PAIRS,
+    CORRUPT_REPEAT,
+    CORRUPT_KINDS
+} corrupt_kind_e;
+
+static const char *const corruptNames[CORRUPT_KINDS] = {"none", "bit_flip", "drop", "insert", "fake_pairs", "repeat"};
+static const char *const corruptModes[2] = {"inline", "deferred"};
+
+static tio_usb_context_t corruptCtx;
+static uint32_t corruptRng = 1;
+static uint32_t corruptRecovered = 0;
+static uint32_t corruptRepeats = 0;
+static uint32_t corruptSeqRepeats = 0;
+static uint8_t corruptStream[1 << 22];
+
+static uint32_t
+corrupt_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+/**
+ * @brief Deterministic xorshift32 so every run sees the same stream
+ */
+static uint32_t
+corrupt_rand(void)
+{
+    corruptRng ^= corruptRng << 13;
+    corruptRng ^= corruptRng >> 17;
+    corruptRng ^= corruptRng << 5;
+    return corruptRng;
+}
+
+static void
+corrupt_slot_cb(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length)
+{
+    (void)slot;
+    (void)slot_type;
+    (void)data;
+    (void)length;
+    corruptRecovered++;
+}
+
+/**
+ * @brief Start from a fresh link w/ compact, numbered frames
+ */
+static void
+corrupt_setup(uint32_t crcBudget, bool deferred)
+{
+    uint16_t caps = TIO_USB_CAP_COMPACT | TIO_USB_CAP_SEQ;
+    uint8_t hello[4] = {0x01, TIO_USB_PROTOCOL_VERSION, caps & 0xFF, caps >> 8};
+    uint8_t packet[TIO_USB_PACKET_LEN];
+    tio_usb_loopback_config_t loop = {0};
+    memset(&corruptCtx, 0, sizeof(corruptCtx));
+    corruptCtx.slot_update_cb = corrupt_slot_cb;
+    corruptCtx.cycles_cb = corrupt_now_ns;
+    corruptCtx.rx_crc_budget = crcBudget;
+    corruptCtx.deferred_rx = deferred;
+    tio_usb_loopback_config(&loop);
+    tio_usb_init(&corruptCtx);
+    tio_usb_pack_slot_data(0, 3, hello, sizeof(hello), packet);
+    tio_usb_loopback_inject(packet, TIO_USB_PACKET_LEN);
+    tio_usb_service();
+    tio_usb_loopback_poll();
+    corruptRecovered = 0;
+}
+
+/**
+ * @brief Append one frame to the stream, damaged by kind
+ *
+ * @return uint32_t Bytes appended
+ */
+static uint32_t
+corrupt_frame(uint8_t *dst, corrupt_kind_e kind)
+{
+    uint8_t frame[TIO_USB_PACKET_LEN];
+    static uint8_t data[TIO_USB_PACKET_LEN];
+    uint32_t dlen = 1 + corrupt_rand() % 248;
+    for (uint32_t i = 0; i < dlen; i++)
+    {
+        data[i] = corrupt_rand();
+    }
+    tio_usb_pack_slot_data(corrupt_rand() % 4, corrupt_rand() & 1, data, dlen, frame);
+    uint32_t len = tio_usb_frame_len(frame);
+    uint32_t pos = corrupt_rand() % len;
+    if (kind == CORRUPT_NONE || corrupt_rand() % 100 >= CORRUPT_RATE_PCT)
+    {
+        memcpy(dst, frame, len);
+        return len;
+    }
+    switch (kind)
+    {
+    case CORRUPT_BIT_FLIP:
+        frame[pos] ^= 1 << (corrupt_rand() & 7);
+        memcpy(dst, frame, len);
+        return len;
+    case CORRUPT_DROP:
+    {
+        uint32_t drop = 1 + corrupt_rand() % CORRUPT_MAX_DROP;
+        drop = drop < len - pos ? drop : len - pos;
+        memcpy(dst, frame, pos);
+        memcpy(dst + pos, frame + pos + drop, len - pos - drop);
+        return len - drop;
+    }
+    case CORRUPT_INSERT:
+    {
+        uint32_t n = 1 + corrupt_rand() % CORRUPT_MAX_INSERT;
+        memcpy(dst, frame, pos);
+        for (uint32_t i = 0; i < n; i++)
+        {
+            dst[pos + i] = corrupt_rand();
+        }
+        memcpy(dst + pos + n, frame + pos, len - pos);
+        return len + n;
+    }
+    case CORRUPT_FAKE_PAIRS:
+    {
+        // Storm ahead of the intact frame, padded so the last fake's stop
+        // byte is still inside it
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < CORRUPT_STORM_PAIRS; i++, n += CORRUPT_PAIR_LEN)
+        {
+            memcpy(dst + n, corruptPair, CORRUPT_PAIR_LEN);
+        }
+        for (uint32_t i = 0; i < 250; i++, n++)
+        {
+            dst[n] = i % CORRUPT_PAIR_LEN == CORRUPT_PAIR_LEN - 1 ? 0xAA : 0x00;
+        }
+        memcpy(dst + n, frame, len);
+        return n + len;
+    }
+    case CORRUPT_REPEAT:
+        // Sent again as is, same sequence number
+        memcpy(dst, frame, len);
+        memcpy(dst + len, frame, len);
+        corruptRepeats++;
+        // Frames whose DATA left no room for a sequence number aren't tracked
+        corruptSeqRepeats += (frame[2] & TIO_USB_FLAG_SEQ) ? 1 : 0;
+        return 2 * len;
+    default:
+        memcpy(dst, frame, len);
+        return len;
+    }
+}
+
+/**
+ * @brief Deliver a burst of frames in one receive and nothing after it
+ *
+ * A pass cut short by rx_crc_budget leaves frames in the RX ring, which
+ * tio_usb_service() has to dispatch w/o waiting for more data.
+ *
+ * @return uint32_t Frames of the burst still undelivered
+ */
+static uint32_t
+corrupt_tail(uint32_t crcBudget, bool deferred)
+{
+    uint8_t data[8] = {0};
+    uint32_t len = 0;
+    // High speed bulk packets, so one receive carries the whole burst
+    tio_usb_loopback_config_t loop = {.packet_len = 512};
+    corrupt_setup(crcBudget, deferred);
+    tio_usb_loopback_config(&loop);
+    for (uint32_t i = 0; i < CORRUPT_TAIL_FRAMES; i++)
+    {
+        tio_usb_pack_slot_data(0, 0, data, sizeof(data), corruptStream + len);
+        len += tio_usb_frame_len(corruptStream + len);
+    }
+    tio_usb_loopback_inject(corruptStream, len);
+    for (uint32_t i = 0; i < 2 * CORRUPT_TAIL_FRAMES && tio_usb_service(); i++)
+    {
+    }
+    return CORRUPT_TAIL_FRAMES - corruptRecovered;
+}
+
+int
+main(int argc, char **argv)
+{
+    uint32_t frames = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 2000;
+    uint32_t budgetNs = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 0;
+    uint32_t crcBudget = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 0) : 0;
+    uint32_t maxFrames = sizeof(corruptStream) / (TIO_USB_PACKET_LEN + CORRUPT_STORM_PAIRS * CORRUPT_PAIR_LEN + 250);
+    int rc = 0;
+    frames = frames < maxFrames ? frames : maxFrames;
+    for (uint32_t run = 0; run < 2 * CORRUPT_KINDS; run++)
+    {
+        uint32_t kind = run % CORRUPT_KINDS;
+        uint32_t deferred = run / CORRUPT_KINDS;
+        corrupt_setup(crcBudget, deferred);
+        corruptRng = 1 + kind;
+        corruptRepeats = 0;
+        corruptSeqRepeats = 0;
+        uint32_t len = 0;
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            len += corrupt_frame(corruptStream + len, (corrupt_kind_e)kind);
+        }
+        double worst = 0.0;
+        double worstCrc = 0.0;
+        uint64_t total = 0;
+        for (uint32_t pos = 0; pos < len; pos += CORRUPT_CHUNK_LEN)
+        {
+            tio_usb_perf_t before, after;
+            uint32_t chunk = len - pos < CORRUPT_CHUNK_LEN ? len - pos : CORRUPT_CHUNK_LEN;
+            tio_usb_get_perf(&before);
+            uint32_t start = corrupt_now_ns();
+            tio_usb_loopback_inject(corruptStream + pos, chunk);
+            tio_usb_service();
+            uint32_t ns = corrupt_now_ns() - start;
+            tio_usb_get_perf(&after);
+            total += ns;
+            worst = (double)ns / chunk > worst ? (double)ns / chunk : worst;
+            double crc = (double)(after.parse_crc_bytes - before.parse_crc_bytes) / chunk;
+            worstCrc = crc > worstCrc ? crc : worstCrc;
+        }
+        // Passes cut short by rx_crc_budget left the rest for later calls
+        tio_usb_perf_t perf;
+        for (;;)
+        {
+            tio_usb_get_perf(&perf);
+            uint32_t hits = perf.parse_budget_hits;
+            uint32_t dispatched = tio_usb_service();
+            tio_usb_get_perf(&perf);
+            if (dispatched == 0 && perf.parse_budget_hits == hits)
+            {
+                break;
+            }
+        }
+        tio_usb_stats_t stats;
+        tio_usb_get_stats(&stats);
+        tio_usb_get_perf(&perf);
+        // Repeats are delivered too, the host's seq tracking tells them apart
+        uint32_t sent = frames + corruptRepeats;
+        printf("{\"mode\":\"%s\",\"kind\":\"%s\",\"frames\":%u,\"bytes\":%u,\"recovered\":%u,\"lost\":%u,\"crc_errors\":%u,"
+               "\"framing_errors\":%u,\"resync_bytes\":%u,\"seq_gaps\":%u,\"seq_repeats\":%u,\"crc_bytes_per_byte\":%.2f,"
+               "\"worst_crc_bytes_per_byte\":%.2f,\"budget_hits\":%u,\"mean_ns_per_byte\":%.2f,"
+               "\"worst_ns_per_byte\":%.2f}\n",
+               corruptModes[deferred], corruptNames[kind], sent, len, corruptRecovered, sent - corruptRecovered, stats.crc_errors,
+               stats.framing_errors, stats.resync_bytes, stats.seq_gaps, stats.seq_repeats, (double)perf.parse_crc_bytes / len,
+               worstCrc, perf.parse_budget_hits, (double)total / len, worst);
+        if (budgetNs && worst > budgetNs)
+        {
+            fprintf(stderr, "%s %s: %.1f ns/byte exceeds budget of %u\n", corruptModes[deferred], corruptNames[kind],
+                    worst, budgetNs);
+            rc = 1;
+        }
+        if (kind == CORRUPT_NONE && corruptRecovered != frames)
+        {
+            fprintf(stderr, "%s none: %u frames lost from a clean stream\n", corruptModes[deferred],
+                    frames - corruptRecovered);
+            rc = 1;
+        }
+        if (kind == CORRUPT_REPEAT && (stats.seq_gaps || stats.seq_repeats != corruptSeqRepeats))
+        {
+            fprintf(stderr, "%s repeat: %u seq gaps, %u of %u repeats counted\n", corruptModes[deferred],
+                    stats.seq_gaps, stats.seq_repeats, corruptSeqRepeats);
+            rc = 1;
+        }
+    }
+    for (uint32_t deferred = 0; deferred < 2; deferred++)
+    {
+        uint32_t lost = corrupt_tail(crcBudget, deferred);
+        if (lost)
+        {
+            fprintf(stderr, "%s tail: %u frames left in the RX ring\n", corruptModes[deferred], lost);
+            rc = 1;
+        }
+    }
+    return rc;
+}
@@ -0,0 +1,374 @@
+/**
+ * @file tio_usb_frag_check.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio USB fragmentation and reassembly round trip check
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * Sends slot messages larger than one frame through the loopback build,
+ * catches the fragment frames at the pipe and feeds them back shuffled,
+ * duplicated or w/ one missing. Checks every complete message is delivered
+ * once and intact, incomplete ones never are, a new message evicts the
+ * least recently used reassembly and a partial message is dropped once
+ * reasm_timeout_us has passed. Prints one JSON object per case and exits
+ * nonzero on any mismatch.
+ *
+ *   ./tio_usb_frag_check [messages]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tio_usb.h"
+
+#define FRAG_SLOT 0
+#define FRAG_SLOT_TYPE 1        // Metric
+#define FRAG_MAX_FRAMES 64      // Fragments of one message incl. duplicates
+#define FRAG_TIMEOUT_US 10000
+#define FRAG_MAX_MESSAGES 4096
+
+typedef enum {
+    FRAG_SHUFFLE = 0,
+    FRAG_DROP,
+    FRAG_LRU,
+    FRAG_TIMEOUT,
+    FRAG_CASES
+} frag_case_e;
+
+static const char *const fragNames[FRAG_CASES] = {"shuffle", "drop", "lru", "timeout"};
+
+typedef struct {
+    uint8_t buf[TIO_USB_PACKET_LEN];
+    uint32_t len;
+} frag_frame_t;
+
+typedef struct {
+    frag_frame_t frames[FRAG_MAX_FRAMES];
+    uint32_t count;
+} frag_msg_t;
+
+static tio_usb_context_t fragCtx;
+static uint32_t fragRng = 1;
+static uint32_t fragNowUs = 0;
+static uint8_t fragCapture[2 * TIO_USB_LOOPBACK_LEN];
+static uint32_t fragCaptureLen = 0;
+static uint8_t fragDelivered[FRAG_MAX_MESSAGES];
+static uint32_t fragBad = 0; // Deliveries not matching any message sent
+static uint32_t fragPackFails = 0;
+
+/**
+ * @brief Deterministic xorshift32 so every run sees the same cases
+ */
+static uint32_t
+frag_rand(void)
+{
+    fragRng ^= fragRng << 13;
+    fragRng ^= fragRng >> 17;
+    fragRng ^= fragRng << 5;
+    return fragRng;
+}
+
+static uint32_t
+frag_tick_us(void)
+{
+    return fragNowUs;
+}
+
+/**
+ * @brief Message m: its number, then bytes derived from it, 2 or more frames long
+ */
+static uint32_t
+frag_msg_len(uint32_t m)
+{
+    uint32_t h = (m + 1) * 2654435761U;
+    return 249 + h % (TIO_USB_REASM_MAX_LEN - 248);
+}
+
+static uint8_t
+frag_msg_byte(uint32_t m, uint32_t i)
+{
+    return i < 4 ? (uint8_t)(m >> (8 * i)) : (uint8_t)(((m + 1) * 2654435761U + i * 40503U) >> 13);
+}
+
+static void
+frag_slot_cb(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length)
+{
+    uint32_t m = length >= 4 ? data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24 : UINT32_MAX;
+    if (slot != FRAG_SLOT || slot_type != FRAG_SLOT_TYPE || m >= FRAG_MAX_MESSAGES || length != frag_msg_len(m))
+    {
+        fragBad++;
+        return;
+    }
+    for (uint32_t i = 0; i < length; i++)
+    {
+        if (data[i] != frag_msg_byte(m, i))
+        {
+            fragBad++;
+            return;
+        }
+    }
+    fragDelivered[m]++;
+}
+
+/**
+ * @brief Catch what the device sends instead of looping it back
+ */
+static uint32_t
+frag_tap(uint8_t *buffer, uint32_t length)
+{
+    if (fragCaptureLen + length <= sizeof(fragCapture))
+    {
+        memcpy(fragCapture + fragCaptureLen, buffer, length);
+        fragCaptureLen += length;
+    }
+    return 0;
+}
+
+/**
+ * @brief Start from a fresh link that takes fragments
+ */
+static void
+frag_setup(void)
+{
+    uint16_t caps = TIO_USB_CAP_COMPACT | TIO_USB_CAP_FRAGMENT;
+    uint8_t hello[4] = {0x01, TIO_USB_PROTOCOL_VERSION, caps & 0xFF, caps >> 8};
+    uint8_t packet[TIO_USB_PACKET_LEN];
+    tio_usb_loopback_config_t loop = {.tap = frag_tap};
+    memset(&fragCtx, 0, sizeof(fragCtx));
+    fragCtx.slot_update_cb = frag_slot_cb;
+    fragCtx.tick_us_cb = frag_tick_us;
+    fragCtx.reasm_timeout_us = FRAG_TIMEOUT_US;
+    tio_usb_loopback_config(&loop);
+    tio_usb_init(&fragCtx);
+    tio_usb_pack_slot_data(0, 3, hello, sizeof(hello), packet);
+    tio_usb_loopback_inject(packet, TIO_USB_PACKET_LEN);
+    tio_usb_flush();
+    tio_usb_loopback_poll();
+    memset(fragDelivered, 0, sizeof(fragDelivered));
+    fragBad = 0;
+    fragPackFails = 0;
+    fragRng = 1;
+}
+
+/**
+ * @brief Send message m and split what reaches the pipe into frames
+ *
+ * @return uint32_t 0 on success
+ */
+static uint32_t
+frag_pack(uint32_t m, frag_msg_t *msg)
+{
+    static uint8_t data[TIO_USB_REASM_MAX_LEN];
+    uint32_t len = frag_msg_len(m);
+    for (uint32_t i = 0; i < len; i++)
+    {
+        data[i] = frag_msg_byte(m, i);
+    }
+    fragCaptureLen = 0;
+    if (tio_usb_send_slot_data(FRAG_SLOT, FRAG_SLOT_TYPE, data, len))
+    {
+        fragPackFails++;
+        return 1;
+    }
+    uint32_t before;
+    do
+    {
+        before = fragCaptureLen;
+        tio_usb_flush();
+        tio_usb_loopback_poll();
+    } while (fragCaptureLen != before);
+    msg->count = 0;
+    for (uint32_t pos = 0; pos < fragCaptureLen && msg->count < FRAG_MAX_FRAMES / 2;)
+    {
+        frag_frame_t *f = &msg->frames[msg->count++];
+        f->len = tio_usb_frame_len(fragCapture + pos);
+        if (f->len == 0 || pos + f->len > fragCaptureLen)
+        {
+            fragPackFails++;
+            return 1;
+        }
+        memcpy(f->buf, fragCapture + pos, f->len);
+        pos += f->len;
+    }
+    fragPackFails += msg->count < 2;
+    return msg->count < 2;
+}
+
+static void
+frag_inject(const frag_frame_t *f)
+{
+    tio_usb_loopback_inject(f->buf, f->len);
+    tio_usb_service();
+}
+
+static void
+frag_shuffle(frag_msg_t *msg)
+{
+    for (uint32_t i = msg->count - 1; i > 0; i--)
+    {
+        uint32_t j = frag_rand() % (i + 1);
+        frag_frame_t t = msg->frames[i];
+        msg->frames[i] = msg->frames[j];
+        msg->frames[j] = t;
+    }
+}
+
+/**
+ * @brief Repeat about one in five fragments somewhere later in the run, but
+ * before the last one (a repeat after the message is complete starts it over)
+ */
+static void
+frag_duplicate(frag_msg_t *msg)
+{
+    uint32_t n = msg->count;
+    for (uint32_t i = 0; i + 1 < n && msg->count < FRAG_MAX_FRAMES; i++)
+    {
+        if (frag_rand() % 5 == 0)
+        {
+            uint32_t at = i + 1 + frag_rand() % (msg->count - 1 - i);
+            memmove(&msg->frames[at + 1], &msg->frames[at], (msg->count - at) * sizeof(frag_frame_t));
+            msg->frames[at] = msg->frames[i];
+            msg->count++;
+        }
+    }
+}
+
+/**
+ * @brief Run one case
+ *
+ * @param expect Per message deliveries expected (0 or 1)
+ * @return uint32_t Messages sent (whole groups of TIO_USB_REASM_CTXS + 1 for
+ *                  the LRU case)
+ */
+static uint32_t
+frag_run(frag_case_e kind, uint32_t messages, uint8_t *expect, uint32_t *injected)
+{
+    static frag_msg_t msgs[TIO_USB_REASM_CTXS + 1];
+    frag_msg_t *msg = &msgs[0];
+    uint32_t m = 0;
+    *injected = 0;
+    switch (kind)
+    {
+    case FRAG_SHUFFLE:
+    case FRAG_DROP:
+        for (; m < messages; m++)
+        {
+            if (frag_pack(m, msg))
+            {
+                break;
+            }
+            frag_shuffle(msg);
+            uint32_t skip = FRAG_MAX_FRAMES;
+            if (kind == FRAG_DROP)
+            {
+                skip = frag_rand() % 4 == 0 ? frag_rand() % msg->count : FRAG_MAX_FRAMES;
+            }
+            else
+            {
+                frag_duplicate(msg);
+            }
+            expect[m] = skip == FRAG_MAX_FRAMES;
+            for (uint32_t i = 0; i < msg->count; i++)
+            {
+                if (i != skip)
+                {
+                    frag_inject(&msg->frames[i]);
+                    (*injected)++;
+                }
+            }
+        }
+        return m;
+    case FRAG_LRU:
+        // Open TIO_USB_REASM_CTXS messages, then one more complete one takes
+        // the least recently used context
+        for (; m + TIO_USB_REASM_CTXS + 1 <= messages; m += TIO_USB_REASM_CTXS + 1)
+        {
+            for (uint32_t k = 0; k <= TIO_USB_REASM_CTXS; k++)
+            {
+                if (frag_pack(m + k, &msgs[k]))
+                {
+                    return m;
+                }
+                expect[m + k] = k != 0;
+            }
+            for (uint32_t k = 0; k < TIO_USB_REASM_CTXS; k++)
+            {
+                frag_inject(&msgs[k].frames[0]);
+                (*injected)++;
+            }
+            for (uint32_t i = 0; i < msgs[TIO_USB_REASM_CTXS].count; i++)
+            {
+                frag_inject(&msgs[TIO_USB_REASM_CTXS].frames[i]);
+                (*injected)++;
+            }
+            for (uint32_t k = 0; k < TIO_USB_REASM_CTXS; k++)
+            {
+                for (uint32_t i = 1; i < msgs[k].count; i++)
+                {
+                    frag_inject(&msgs[k].frames[i]);
+                    (*injected)++;
+                }
+            }
+        }
+        return m;
+    case FRAG_TIMEOUT:
+        // The last fragment arrives just before or right at the timeout
+        for (; m < messages; m++)
+        {
+            if (frag_pack(m, msg))
+            {
+                break;
+            }
+            bool late = m & 1;
+            expect[m] = !late;
+            for (uint32_t i = 0; i < msg->count; i++)
+            {
+                if (i + 1 == msg->count)
+                {
+                    fragNowUs += late ? FRAG_TIMEOUT_US : FRAG_TIMEOUT_US - 1;
+                }
+                frag_inject(&msg->frames[i]);
+                (*injected)++;
+            }
+        }
+        return m;
+    default:
+        return 0;
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    static uint8_t expect[FRAG_MAX_MESSAGES];
+    uint32_t messages = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 1000;
+    int rc = 0;
+    messages = messages < FRAG_MAX_MESSAGES ? messages : FRAG_MAX_MESSAGES;
+    for (uint32_t kind = 0; kind < FRAG_CASES; kind++)
+    {
+        uint32_t injected;
+        frag_setup();
+        memset(expect, 0, sizeof(expect));
+        uint32_t sent = frag_run((frag_case_e)kind, messages, expect, &injected);
+        uint32_t expected = 0, delivered = 0, wrong = 0;
+        for (uint32_t m = 0; m < sent; m++)
+        {
+            expected += expect[m];
+            delivered += fragDelivered[m];
+            wrong += fragDelivered[m] != expect[m];
+        }
+        printf("{\"case\":\"%s\",\"messages\":%u,\"fragments\":%u,\"expected\":%u,\"delivered\":%u,\"wrong\":%u,"
+               "\"corrupt\":%u}\n",
+               fragNames[kind], sent, injected, expected, delivered, wrong, fragBad);
+        if (fragPackFails || wrong || fragBad)
+        {
+            fprintf(stderr, "%s: %u messages not sent, %u delivered wrongly, %u corrupt\n", fragNames[kind],
+                    fragPackFails, wrong, fragBad);
+            rc = 1;
+        }
+    }
+    return rc;
+}
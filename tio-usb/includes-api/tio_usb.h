@@ -16,26 +16,250 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
+#ifndef TIO_HOST_BUILD
 #include "arm_math.h"
+#endif
+#include "tio_core.h"
 
 #define TIO_USB_PACKET_LEN 256
+#define TIO_USB_PROTOCOL_VERSION 2
+
+// Capabilities negotiated via HELLO control frame
+#define TIO_USB_CAP_COMPACT (1 << 0)
+#define TIO_USB_CAP_FRAGMENT (1 << 1)
+#define TIO_USB_CAP_SEQ (1 << 2) // Requires TIO_USB_CAP_COMPACT
+#define TIO_USB_CAP_CODEC (1 << 3)
+#define TIO_USB_CAP_BULK (1 << 4)
+#define TIO_USB_CAP_TIMESTAMP (1 << 5) // Requires TIO_USB_CAP_COMPACT and a tick_us_cb
+#define TIO_USB_CAP_RATE (1 << 6)
+
+// STYPE flags
+#define TIO_USB_FLAG_COMPACT 0x80
+#define TIO_USB_FLAG_FRAGMENT 0x40
+#define TIO_USB_FLAG_SEQ 0x20
+#define TIO_USB_FLAG_CODEC 0x10
+#define TIO_USB_FLAG_TS 0x08
+
+#define TIO_USB_SLOTS TIO_SLOTS
 
 
 // A USB slot frame is 256 bytes long w/ fields:
 //   START: 1 byte      [0x55]
-//    SLOT: 1 byte      [0 - ch0, 1 - ch1, 2 - ch2, 3 - ch3]
-//   STYPE: 1 byte      [0 - signal, 1 - metric, 2 - uio]
+//    SLOT: 1 byte      [0 - TIO_SLOTS-1, see TIO_SLOT_TABLE] | rate << 4
+//   STYPE: 1 byte      [0 - signal, 1 - metric, 2 - uio, 3 - control, 4 - bulk] | flags
 //  LENGTH: 2 bytes     [0 - 248]
 //    DATA: 248 bytes   [...]
 //     CRC: 2 bytes     [CRC16]
 //    STOP: 1 byte      [0xAA]
+//
+// A compact frame (STYPE | 0x80) drops the unused DATA bytes and is LENGTH + 8
+// bytes long. The device only sends compact frames once the host has enabled
+// TIO_USB_CAP_COMPACT w/ a HELLO control frame (replies are always fixed):
+//   host -> device: [0x01, version, caps (2 bytes)]
+//   device -> host: [0x01, version, accepted caps (2 bytes)]
+// Both forms are always accepted on receive.
+//
+// A fragment frame (STYPE | 0x40) carries one piece of a slot message larger
+// than 248 bytes. Its DATA starts w/ a 3 byte fragment header:
+//   MSG ID: 1 byte     [Per-sender running counter]
+//    INDEX: 1 byte     [0 - COUNT-1]
+//    COUNT: 1 byte     [Fragments in message]
+// followed by up to 245 payload bytes; every fragment but the last is full.
+// The device only sends fragments once the host has enabled
+// TIO_USB_CAP_FRAGMENT, and reassembles received fragments in any order.
+//
+// A compact frame may also carry a per-slot sequence number (STYPE | 0x20) in
+// one extra byte between DATA and CRC (which covers it). The frame is then
+// LENGTH + 9 bytes long, so frames w/ a full 248 byte DATA field go w/o one.
+// The device numbers its slot data frames (types 0-2) once the host has
+// enabled TIO_USB_CAP_SEQ, and counts gaps in numbered slot data frames it
+// receives. Control and bulk frames are never numbered.
+//
+// A compact frame may carry a timestamp (STYPE | 0x08): the tick_us_cb value
+// when it was packed, 4 bytes little endian between DATA and the sequence
+// number (if any), also covered by the CRC. Frames whose DATA leaves no room
+// for it go w/o one. The device stamps its slot data frames once the host
+// has enabled TIO_USB_CAP_TIMESTAMP, which needs a tick_us_cb. For clock sync
+// the host sends a PING control frame (w/ any framing) and gets a PONG back:
+//   host -> device: [0x02, id, host time (8 bytes)]
+//   device -> host: [0x02, id, host time (8 bytes), device time (4 bytes)]
+// Device time is taken when the PING is handled, so the host can estimate
+// the clock offset as device time - (host send + host receive) / 2, best
+// taken from the PONG w/ the shortest round trip.
+//
+// Signal frames of slots under rate control (see TIO_RATE_* in tio_core.h)
+// carry samples decimated by `rate` (2 - 15) in the upper SLOT nibble once
+// the host has enabled TIO_USB_CAP_RATE; 0 means full rate. W/o it the slots
+// are held at full rate while the USB link is up.
+//
+// A codec frame (STYPE | 0x10) carries int16 signal samples as a block
+// encoded w/ tio_codec_encode() (see tio_codec.h), decoded by the host w/
+// tio_codec_decode(). The device only sends them for slots w/ a codec set and
+// once the host has enabled TIO_USB_CAP_CODEC; it doesn't accept them.
+//
+// Bulk frames (STYPE 4) stream one large object host -> device into the
+// buffer or sink of tio_usb_bulk_config_t. The host checks for
+// TIO_USB_CAP_BULK in the HELLO reply. DATA starts w/ an opcode, multi-byte
+// fields are little endian:
+//   OPEN:  [0x01, id, length (4 bytes), CRC32 (4 bytes)]
+//   DATA:  [0x02, id, offset (4 bytes), up to 242 bytes]
+//   ABORT: [0x03, id]
+//   ACK:   [0x04, id, status, window, next offset (4 bytes)]  (device -> host)
+// The device acks OPEN w/ the offset to send from: 0 for a new object, or
+// where it left off if id, length and CRC32 match the object in progress, so
+// a host can resume after a detach or restart. The host keeps at most
+// `window` DATA frames past the last acked offset in flight. The device takes
+// DATA in order only, acks every window/2 frames, and acks the expected
+// offset once when a frame arrives out of order so the host can rewind
+// (go-back-N). Once the last byte arrives it checks the CRC32 (IEEE 802.3,
+// tio_crc32_update()) over the object, calls done_cb and sends a final ACK
+// w/ the status.
 
-typedef void (*pfnSlotUpdate)(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length);
-typedef void (*pfnUioUpdate)(const uint8_t *data, uint32_t length);
+typedef void (*pfnTxFlush)(uint32_t frames, uint32_t bytes);
+typedef uint32_t (*pfnCycles)(void);
+typedef uint32_t (*pfnBulkSink)(uint8_t id, uint32_t offset, const uint8_t *data, uint32_t length);
+
+#ifndef TIO_USB_TX_STAGE_LEN
+#define TIO_USB_TX_STAGE_LEN 2048
+#endif
+
+// TX coalescing: frames are staged and sent as one transfer once the next
+// frame would exceed max_bytes, the oldest staged frame is max_latency_us old
+// (checked in send and tio_usb_service()), or on tio_usb_flush().
+typedef struct {
+    uint32_t max_bytes;
+    uint32_t max_latency_us; // 0 - send each frame immediately
+} tio_usb_batch_config_t;
+
+#define TIO_USB_BATCH_LOW_LATENCY {TIO_USB_PACKET_LEN, 0}
+#define TIO_USB_BATCH_THROUGHPUT {TIO_USB_TX_STAGE_LEN, 4000}
+
+// Frames that can't be sent right away wait in priority lanes: metric, UIO and
+// control frames (lane 0) always go out before signal frames (lane 1).
+#ifndef TIO_USB_TXQ_HI_DEPTH
+#define TIO_USB_TXQ_HI_DEPTH 4
+#endif
+#ifndef TIO_USB_TXQ_LO_DEPTH
+#define TIO_USB_TXQ_LO_DEPTH 8
+#endif
+#define TIO_USB_TX_LANES 2
+#define TIO_USB_TX_POLICIES 3 // Per slot type (signal, metric, uio)
+
+// Reassembly of received fragmented messages
+#ifndef TIO_USB_REASM_CTXS
+#define TIO_USB_REASM_CTXS 2 // Messages in flight at once (oldest evicted)
+#endif
+#ifndef TIO_USB_REASM_MAX_LEN
+#define TIO_USB_REASM_MAX_LEN 4096 // Max 7840 (32 fragments)
+#endif
+#define TIO_USB_REASM_TIMEOUT_US 100000
+
+typedef enum {
+    TIO_USB_DROP_NEWEST = 0, // Refuse the new frame
+    TIO_USB_DROP_OLDEST,     // Evict the oldest queued frame
+    TIO_USB_BLOCK,           // Wait up to timeout_us (needs tick_us_cb), then refuse
+} tio_usb_drop_policy_e;
+
+typedef struct {
+    tio_usb_drop_policy_e policy;
+    uint32_t timeout_us;
+} tio_usb_tx_policy_t;
+
+typedef struct {
+    uint32_t queued;  // Frames that had to wait in the lane
+    uint32_t sent;    // Frames handed to USB
+    uint32_t dropped; // Frames refused, evicted or dropped on detach
+    uint32_t max_depth; // Most frames waiting at once
+} tio_usb_tx_lane_stats_t;
+
+typedef struct {
+    tio_usb_tx_lane_stats_t lanes[TIO_USB_TX_LANES];
+    uint32_t stage_max; // Most bytes staged at once
+} tio_usb_tx_stats_t;
+
+// Bulk downlink
+#ifndef TIO_USB_BULK_WINDOW
+#define TIO_USB_BULK_WINDOW 12 // Max DATA frames in flight, must fit the 4 KB RX ring
+#endif
+
+typedef enum {
+    TIO_USB_BULK_OK = 0,
+    TIO_USB_BULK_IN_PROGRESS,
+    TIO_USB_BULK_TOO_LARGE, // Object doesn't fit the buffer
+    TIO_USB_BULK_NO_SINK,   // Neither buffer nor sink_cb set
+    TIO_USB_BULK_CRC_ERROR, // Object CRC32 mismatch
+    TIO_USB_BULK_ABORTED,   // Aborted by host, sink or a newer object
+} tio_usb_bulk_status_e;
+
+typedef void (*pfnBulkDone)(uint8_t id, uint32_t length, tio_usb_bulk_status_e status);
+
+typedef struct {
+    uint8_t *buffer;     // Destination (object at offset 0), or NULL to use sink_cb
+    uint32_t buffer_len;
+    pfnBulkSink sink_cb; // Called w/ data in order, nonzero return aborts the object
+    pfnBulkDone done_cb; // Optional, called once the object completes or is dropped
+    uint8_t window;      // DATA frames in flight (0 - TIO_USB_BULK_WINDOW)
+} tio_usb_bulk_config_t;
+
+typedef struct {
+    uint8_t id;
+    tio_usb_bulk_status_e status; // Of the current or last object
+    uint32_t length;
+    uint32_t received;            // Bytes received in order
+    uint32_t rejected;            // DATA frames out of order or w/o an open object
+} tio_usb_bulk_state_t;
+
+// Link quality counters, free-running since tio_usb_init()
+typedef struct {
+    uint32_t tx_frames;      // Frames handed to USB
+    uint32_t tx_busy;        // Frames refused or evicted because USB was busy or detached
+    uint32_t rx_frames;      // Valid frames received
+    uint32_t crc_errors;     // Frames failing CRC
+    uint32_t framing_errors; // Frames w/ bad start/stop byte or length
+    uint32_t resync_bytes;   // Bytes skipped looking for the next frame
+    uint32_t rx_overflows;   // Bytes lost to a full RX ring
+    uint32_t seq_gaps;       // Numbered frames missing from the host
+    uint32_t seq_repeats;    // Numbered frames from the host repeated or behind the sequence
+} tio_usb_stats_t;
+
+// Hot path work counters. Cycles are only counted w/ a cycles_cb, in its
+// units (e.g. DWT cycle counter on target, nanoseconds on host).
+typedef struct {
+    uint32_t pack_frames;       // Frames packed for TX (incl. queued and fragments)
+    uint64_t pack_cycles;       // Spent in tio_usb_send_* and the core transport
+    uint32_t parse_frames;      // Frames dispatched by the RX parser
+    uint64_t parse_cycles;      // Spent parsing the RX ring (incl. resync and callbacks)
+    uint32_t parse_max_cycles;  // Longest single parse pass
+    uint32_t parse_bytes;       // Bytes consumed by the parser (frames and resync)
+    uint32_t parse_crc_bytes;   // Bytes CRC'd checking candidate frames
+    uint32_t parse_budget_hits; // Parse passes cut short by rx_crc_budget
+    uint32_t rx_ring_max;       // Most bytes waiting in the RX ring at once
+} tio_usb_perf_t;
+
+// Per-slot time from packing a timestamped frame to handing it to USB. Bucket
+// 0 counts frames under 1 us, bucket b [2^(b-1), 2^b) us and the last bucket
+// everything longer.
+#define TIO_USB_LAT_BUCKETS 16
+
+typedef struct {
+    uint32_t buckets[TIO_USB_LAT_BUCKETS];
+    uint32_t max_us;
+} tio_usb_latency_t;
 
 typedef struct {
     volatile pfnUioUpdate uio_update_cb;
     volatile pfnSlotUpdate slot_update_cb;
+    bool deferred_rx; // Parse frames in tio_usb_service() rather than the USB receive callback
+    pfnTickUs tick_us_cb; // Optional microsecond tick source (also frame timestamps and PONG)
+    tio_usb_batch_config_t batch;
+    pfnTxFlush tx_flush_cb; // Optional, called w/ frames and bytes of each coalesced transfer
+    tio_usb_tx_policy_t tx_policy[TIO_USB_TX_POLICIES]; // Lane full policy (zeroed - drop newest)
+    uint32_t reasm_timeout_us; // Drop partial messages after this (0 - default, needs tick_us_cb)
+    uint8_t codec[TIO_USB_SLOTS]; // Signal slot codec (TIO_CODEC_*), data is then int16 samples
+    pfnCycles cycles_cb; // Optional free-running counter for tio_usb_get_perf()
+    uint32_t rx_crc_budget; // CRC bytes per parse pass before leaving the rest to tio_usb_service() (0 - unlimited)
+    tio_usb_bulk_config_t bulk; // Bulk downlink destination
 } tio_usb_context_t;
 
 uint32_t
@@ -50,6 +274,74 @@ uint32_t
 tio_usb_send_slot_data(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length);
 uint32_t
 tio_usb_send_uio_state(const uint8_t *data, uint32_t length);
+uint32_t
+tio_usb_service(void);
+uint32_t
+tio_usb_flush(void);
+void
+tio_usb_get_tx_stats(tio_usb_tx_stats_t *stats);
+void
+tio_usb_get_stats(tio_usb_stats_t *stats);
+uint8_t *
+tio_usb_frame_reserve(uint8_t slot, uint8_t slot_type);
+uint32_t
+tio_usb_frame_commit(uint8_t *frame, uint32_t length);
+void
+tio_usb_frame_cancel(uint8_t *frame);
+uint32_t
+tio_usb_frame_len(const uint8_t *packet);
+uint16_t
+tio_usb_get_caps(void);
+void
+tio_usb_get_perf(tio_usb_perf_t *perf);
+void
+tio_usb_get_bulk(tio_usb_bulk_state_t *state);
+uint32_t
+tio_usb_get_latency(uint8_t slot, tio_usb_latency_t *latency);
+
+// Transport for tio_core.h fan-out (after tio_usb_init())
+extern const tio_transport_t tioUsbTransport;
+
+#ifdef TIO_USB_HOST_LOOPBACK
+// Host loopback build: USB is replaced by a pipe that feeds every transfer
+// the device sends back into its own receive path, so pack and parse run
+// off-target. Control frames are consumed by the pipe (standing in for the
+// host) rather than looped back, as are bulk ACKs; host_cb sees both.
+// Nothing moves until tio_usb_loopback_poll(). Built by tio-usb/host/Makefile,
+// whose benchmark scenarios run on it.
+#ifndef TIO_USB_LOOPBACK_LEN
+#define TIO_USB_LOOPBACK_LEN 8192
+#endif
+
+// Optional, may rewrite a transfer (e.g. corrupt bytes) before it's looped
+// back; returns bytes to deliver (at most length)
+typedef uint32_t (*pfnLoopbackTap)(uint8_t *buffer, uint32_t length);
+typedef void (*pfnLoopbackHost)(const uint8_t *frame, uint32_t length);
+
+typedef struct {
+    uint32_t packet_len; // Receive chunk size (0 - 64, full speed bulk packet)
+    uint32_t window;     // Bytes the endpoint takes before a poll (0 - TIO_USB_LOOPBACK_LEN)
+    bool unmounted;      // Report the device as detached
+    pfnLoopbackTap tap;
+    pfnLoopbackHost host_cb; // Optional, gets each frame consumed by the host end
+} tio_usb_loopback_config_t;
+
+typedef struct {
+    uint32_t transfers;   // Transfers sent by the device
+    uint32_t tx_bytes;    // Bytes sent by the device
+    uint32_t rx_bytes;    // Bytes looped back or injected
+    uint32_t ctrl_frames; // Control and bulk frames consumed
+} tio_usb_loopback_stats_t;
+
+void
+tio_usb_loopback_config(const tio_usb_loopback_config_t *cfg);
+uint32_t
+tio_usb_loopback_inject(const uint8_t *buffer, uint32_t length);
+uint32_t
+tio_usb_loopback_poll(void);
+void
+tio_usb_loopback_get_stats(tio_usb_loopback_stats_t *stats);
+#endif // TIO_USB_HOST_LOOPBACK
 
 
 #ifdef __cplusplus
@@ -1,4 +1,5 @@
-local_src := $(wildcard $(subdirectory)/src/*.c)
+# USB stack stand-ins are only built on the host (host/Makefile)
+local_src := $(filter-out $(subdirectory)/src/tio_usb_loopback.c,$(wildcard $(subdirectory)/src/*.c))
 local_src += $(wildcard $(subdirectory)/src/*.cc)
 local_src += $(wildcard $(subdirectory)/src/*.cpp)
 local_src += $(wildcard $(subdirectory)/src/*.s)
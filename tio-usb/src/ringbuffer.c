@@ -14,6 +14,47 @@
 #include <string.h>
 #include "ringbuffer.h"
 
+/**
+ * @brief Wrap an index that is at most one lap past the end
+ */
+static inline uint32_t
+rb_wrap(const rb_config_t *ctx, size_t idx) {
+    if ((ctx->size & (ctx->size - 1)) == 0) {
+        return idx & (ctx->size - 1);
+    }
+    return idx >= ctx->size ? idx - ctx->size : idx;
+}
+
+/**
+ * @brief Copy elements into the ring starting at idx (handles wraparound)
+ */
+static void
+rb_copy_in(rb_config_t *ctx, uint32_t idx, const void *data, size_t len) {
+    size_t first = ctx->size - idx;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(((char *)ctx->buffer) + idx * ctx->dlen, data, first * ctx->dlen);
+    if (len > first) {
+        memcpy(ctx->buffer, ((const char *)data) + first * ctx->dlen, (len - first) * ctx->dlen);
+    }
+}
+
+/**
+ * @brief Copy elements out of the ring starting at idx (handles wraparound)
+ */
+static void
+rb_copy_out(rb_config_t *ctx, uint32_t idx, void *data, size_t len) {
+    size_t first = ctx->size - idx;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(data, ((char *)ctx->buffer) + idx * ctx->dlen, first * ctx->dlen);
+    if (len > first) {
+        memcpy(((char *)data) + first * ctx->dlen, ctx->buffer, (len - first) * ctx->dlen);
+    }
+}
+
 size_t ringbuffer_len(rb_config_t *ctx) {
     if (ctx->head >= ctx->tail) {
         return ctx->head - ctx->tail;
@@ -23,47 +64,54 @@ size_t ringbuffer_len(rb_config_t *ctx) {
 }
 
 size_t ringbuffer_space(rb_config_t *ctx) {
-    return ctx->size - ringbuffer_len(ctx);
+    // One slot is kept free so a full ring is distinguishable from an empty one
+    return ctx->size - 1 - ringbuffer_len(ctx);
 }
 
 size_t ringbuffer_push(rb_config_t *ctx, void *data, size_t len) {
-    for (size_t i = 0; i < len; i++) {
-        if (ringbuffer_space(ctx) == 0) {
-            return i;
-        }
-        memcpy(((char *)ctx->buffer) + ctx->head * ctx->dlen, ((char *)data) + i * ctx->dlen, ctx->dlen);
-        ctx->head = (ctx->head + 1) % ctx->size;
-    }
-    return len;
+    size_t space = ringbuffer_space(ctx);
+    size_t amt = len > space ? space : len;
+    rb_copy_in(ctx, ctx->head, data, amt);
+    ctx->head = rb_wrap(ctx, ctx->head + amt);
+    return amt;
 }
 
 size_t ringbuffer_fill(rb_config_t *ctx, void* value, size_t len) {
     size_t space = ringbuffer_space(ctx);
     size_t amt = len > space ? space : len;
-    for (size_t i = 0; i < amt; i++) {
-        memcpy(((char *)ctx->buffer) + ctx->head * ctx->dlen, value, ctx->dlen);
-        ctx->head = (ctx->head + 1) % ctx->size;
+    size_t first = ctx->size - ctx->head;
+    if (first > amt) {
+        first = amt;
+    }
+    if (ctx->dlen == 1) {
+        memset(((char *)ctx->buffer) + ctx->head, *(uint8_t *)value, first);
+        memset(ctx->buffer, *(uint8_t *)value, amt - first);
+    } else {
+        char *dst = ((char *)ctx->buffer) + ctx->head * ctx->dlen;
+        for (size_t i = 0; i < amt; i++) {
+            if (i == first) {
+                dst = (char *)ctx->buffer;
+            }
+            memcpy(dst, value, ctx->dlen);
+            dst += ctx->dlen;
+        }
     }
+    ctx->head = rb_wrap(ctx, ctx->head + amt);
     return amt;
 }
 
 size_t ringbuffer_pop(rb_config_t *ctx, void *data, size_t len) {
-    for (size_t i = 0; i < len; i++) {
-        if (ringbuffer_len(ctx) == 0) {
-            return i;
-        }
-        memcpy(((char *)data) + i * ctx->dlen, ((char *)ctx->buffer) + ctx->tail * ctx->dlen, ctx->dlen);
-        ctx->tail = (ctx->tail + 1) % ctx->size;
-    }
-    return len;
+    size_t size = ringbuffer_len(ctx);
+    size_t amt = len > size ? size : len;
+    rb_copy_out(ctx, ctx->tail, data, amt);
+    ctx->tail = rb_wrap(ctx, ctx->tail + amt);
+    return amt;
 }
 
 void
 ringbuffer_replace(rb_config_t *ctx, void *data, size_t len) {
-    for (size_t i = 0; i < len; i++) {
-        memcpy(((char *)ctx->buffer) + ctx->tail * ctx->dlen, ((char *)data) + i * ctx->dlen, ctx->dlen);
-        ctx->tail = (ctx->tail + 1) % ctx->size;
-    }
+    rb_copy_in(ctx, ctx->tail, data, len);
+    ctx->tail = rb_wrap(ctx, ctx->tail + len);
 }
 
 void
@@ -74,39 +122,69 @@ ringbuffer_reset(rb_config_t *ctx) {
 
 size_t
 ringbuffer_peek(rb_config_t *ctx, void *data, size_t len) {
-    size_t tail = ctx->tail;
-    for (size_t i = 0; i < len; i++) {
-        if (ringbuffer_len(ctx) == 0) {
-            return i;
-        }
-        memcpy(((char *)data) + i * ctx->dlen, ((char *)ctx->buffer) + tail * ctx->dlen, ctx->dlen);
-        tail = (tail + 1) % ctx->size;
-    }
-    return len;
+    size_t size = ringbuffer_len(ctx);
+    size_t amt = len > size ? size : len;
+    rb_copy_out(ctx, ctx->tail, data, amt);
+    return amt;
 }
 
 size_t
 ringbuffer_seek(rb_config_t *ctx, size_t len) {
     size_t size = ringbuffer_len(ctx);
     size_t amt = len > size ? size : len;
-    ctx->tail = (ctx->tail + amt) % ctx->size;
+    ctx->tail = rb_wrap(ctx, ctx->tail + amt);
     return amt;
 }
 
+void *
+ringbuffer_reserve(rb_config_t *ctx, size_t *len) {
+    size_t space = ringbuffer_space(ctx);
+    size_t contig = ctx->size - ctx->head;
+    if (contig > space) {
+        contig = space;
+    }
+    if (*len > contig) {
+        *len = contig;
+    }
+    return contig ? ((char *)ctx->buffer) + ctx->head * ctx->dlen : NULL;
+}
+
+void
+ringbuffer_commit(rb_config_t *ctx, size_t len) {
+    ctx->head = rb_wrap(ctx, ctx->head + len);
+}
+
+void *
+ringbuffer_front(rb_config_t *ctx, size_t *len) {
+    size_t size = ringbuffer_len(ctx);
+    size_t contig = ctx->size - ctx->tail;
+    *len = contig > size ? size : contig;
+    return size ? ((char *)ctx->buffer) + ctx->tail * ctx->dlen : NULL;
+}
+
 size_t
 ringbuffer_transfer(rb_config_t *src, rb_config_t *dst, size_t len) {
     if (src->dlen != dst->dlen) {
         return 0;
     }
     size_t size = ringbuffer_len(src);
+    size_t space = ringbuffer_space(dst);
     size_t amt = len > size ? size : len;
-    for (size_t i = 0; i < amt; i++) {
-        if (ringbuffer_space(dst) == 0) {
-            return i;
+    amt = amt > space ? space : amt;
+    // At most three contiguous runs since each side wraps at most once
+    size_t remaining = amt;
+    while (remaining) {
+        size_t chunk = remaining;
+        if (chunk > src->size - src->tail) {
+            chunk = src->size - src->tail;
+        }
+        if (chunk > dst->size - dst->head) {
+            chunk = dst->size - dst->head;
         }
-        memcpy(((char *)dst->buffer) + dst->head * dst->dlen, ((char *)src->buffer) + src->tail * src->dlen, src->dlen);
-        src->tail = (src->tail + 1) % src->size;
-        dst->head = (dst->head + 1) % dst->size;
+        memcpy(((char *)dst->buffer) + dst->head * dst->dlen, ((char *)src->buffer) + src->tail * src->dlen, chunk * src->dlen);
+        src->tail = rb_wrap(src, src->tail + chunk);
+        dst->head = rb_wrap(dst, dst->head + chunk);
+        remaining -= chunk;
     }
     return amt;
 }
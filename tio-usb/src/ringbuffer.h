@@ -17,6 +17,7 @@ extern "C" {
 
 
 #include <stdint.h>
+#include <stddef.h>
 
 typedef struct {
     void *buffer;
@@ -98,6 +99,35 @@ ringbuffer_peek(rb_config_t *ctx, void *data, size_t len);
 size_t
 ringbuffer_seek(rb_config_t *ctx, size_t len);
 
+/**
+ * @brief Get contiguous free space to write in place
+ *
+ * @param ctx Ringbuffer context
+ * @param len In: elements wanted, Out: contiguous elements granted
+ * @return void* Start of free region or NULL if full
+ */
+void *
+ringbuffer_reserve(rb_config_t *ctx, size_t *len);
+
+/**
+ * @brief Publish elements written into reserved space
+ *
+ * @param ctx Ringbuffer context
+ * @param len Length of data (<= granted)
+ */
+void
+ringbuffer_commit(rb_config_t *ctx, size_t len);
+
+/**
+ * @brief Get contiguous readable data in place
+ *
+ * @param ctx Ringbuffer context
+ * @param len Out: contiguous elements readable
+ * @return void* Oldest element or NULL if empty
+ */
+void *
+ringbuffer_front(rb_config_t *ctx, size_t *len);
+
 /**
  * @brief Transfer data from one ringbuffer to another
  *
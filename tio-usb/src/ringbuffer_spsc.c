@@ -0,0 +1,126 @@
+/**
+ * @file ringbuffer_spsc.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Lock-free single-producer/single-consumer ring buffer
+ * @version 1.0
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "ringbuffer_spsc.h"
+
+// Own index is read relaxed; the peer index is read w/ acquire so its data
+// accesses are visible, and our index is published w/ release.
+
+size_t
+ringbuffer_spsc_len(rb_spsc_t *ctx) {
+    uint32_t tail = atomic_load_explicit(&ctx->tail, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&ctx->head, memory_order_acquire);
+    return head - tail;
+}
+
+size_t
+ringbuffer_spsc_space(rb_spsc_t *ctx) {
+    return ctx->size - ringbuffer_spsc_len(ctx);
+}
+
+size_t
+ringbuffer_spsc_push(rb_spsc_t *ctx, const void *data, size_t len) {
+    uint32_t head = atomic_load_explicit(&ctx->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ctx->tail, memory_order_acquire);
+    size_t space = ctx->size - (head - tail);
+    size_t amt = len > space ? space : len;
+    uint32_t idx = head & (ctx->size - 1);
+    size_t first = ctx->size - idx;
+    if (first > amt) {
+        first = amt;
+    }
+    memcpy(((char *)ctx->buffer) + idx * ctx->dlen, data, first * ctx->dlen);
+    if (amt > first) {
+        memcpy(ctx->buffer, ((const char *)data) + first * ctx->dlen, (amt - first) * ctx->dlen);
+    }
+    atomic_store_explicit(&ctx->head, head + (uint32_t)amt, memory_order_release);
+    return amt;
+}
+
+void *
+ringbuffer_spsc_reserve(rb_spsc_t *ctx, size_t *len) {
+    uint32_t head = atomic_load_explicit(&ctx->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ctx->tail, memory_order_acquire);
+    size_t space = ctx->size - (head - tail);
+    uint32_t idx = head & (ctx->size - 1);
+    size_t contig = ctx->size - idx;
+    if (contig > space) {
+        contig = space;
+    }
+    if (*len > contig) {
+        *len = contig;
+    }
+    return contig ? ((char *)ctx->buffer) + idx * ctx->dlen : NULL;
+}
+
+void
+ringbuffer_spsc_commit(rb_spsc_t *ctx, size_t len) {
+    uint32_t head = atomic_load_explicit(&ctx->head, memory_order_relaxed);
+    atomic_store_explicit(&ctx->head, head + (uint32_t)len, memory_order_release);
+}
+
+size_t
+ringbuffer_spsc_peek(rb_spsc_t *ctx, void *data, size_t len) {
+    const void *seg0, *seg1;
+    size_t len0, len1;
+    size_t size = ringbuffer_spsc_segments(ctx, &seg0, &len0, &seg1, &len1);
+    size_t amt = len > size ? size : len;
+    size_t first = amt > len0 ? len0 : amt;
+    memcpy(data, seg0, first * ctx->dlen);
+    if (amt > first) {
+        memcpy(((char *)data) + first * ctx->dlen, seg1, (amt - first) * ctx->dlen);
+    }
+    return amt;
+}
+
+size_t
+ringbuffer_spsc_pop(rb_spsc_t *ctx, void *data, size_t len) {
+    size_t amt = ringbuffer_spsc_peek(ctx, data, len);
+    return ringbuffer_spsc_seek(ctx, amt);
+}
+
+size_t
+ringbuffer_spsc_segments(rb_spsc_t *ctx, const void **seg0, size_t *len0, const void **seg1, size_t *len1) {
+    uint32_t tail = atomic_load_explicit(&ctx->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ctx->head, memory_order_acquire);
+    size_t size = head - tail;
+    uint32_t idx = tail & (ctx->size - 1);
+    size_t first = ctx->size - idx;
+    if (first > size) {
+        first = size;
+    }
+    *seg0 = ((const char *)ctx->buffer) + idx * ctx->dlen;
+    *len0 = first;
+    *seg1 = ctx->buffer;
+    *len1 = size - first;
+    return size;
+}
+
+size_t
+ringbuffer_spsc_seek(rb_spsc_t *ctx, size_t len) {
+    uint32_t tail = atomic_load_explicit(&ctx->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ctx->head, memory_order_acquire);
+    size_t size = head - tail;
+    size_t amt = len > size ? size : len;
+    atomic_store_explicit(&ctx->tail, tail + (uint32_t)amt, memory_order_release);
+    return amt;
+}
+
+size_t
+ringbuffer_spsc_flush(rb_spsc_t *ctx) {
+    uint32_t tail = atomic_load_explicit(&ctx->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ctx->head, memory_order_acquire);
+    atomic_store_explicit(&ctx->tail, head, memory_order_release);
+    return head - tail;
+}
@@ -0,0 +1,139 @@
+/**
+ * @file ringbuffer_spsc.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Lock-free single-producer/single-consumer ring buffer
+ * @version 1.0
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __RINGBUFFER_SPSC_H
+#define __RINGBUFFER_SPSC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+// head is only written by the producer and tail only by the consumer. Both are
+// free-running element counters, so size must be a power of two and the full
+// capacity is usable.
+typedef struct {
+    void *buffer;
+    size_t dlen;
+    uint32_t size;
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+} rb_spsc_t;
+
+/**
+ * @brief Ringbuffer length (either side)
+ *
+ * @param ctx Ringbuffer context
+ * @return size_t
+ */
+size_t
+ringbuffer_spsc_len(rb_spsc_t *ctx);
+
+/**
+ * @brief Ringbuffer space (either side)
+ *
+ * @param ctx Ringbuffer context
+ * @return size_t
+ */
+size_t
+ringbuffer_spsc_space(rb_spsc_t *ctx);
+
+/**
+ * @brief Push data to ringbuffer (producer)
+ *
+ * @param ctx Ringbuffer context
+ * @param data Data to push
+ * @param len Length of data
+ * @return size_t Elements pushed
+ */
+size_t
+ringbuffer_spsc_push(rb_spsc_t *ctx, const void *data, size_t len);
+
+/**
+ * @brief Reserve contiguous space to write in place (producer)
+ *
+ * @param ctx Ringbuffer context
+ * @param len In: elements wanted, Out: contiguous elements granted
+ * @return void* Start of reserved region or NULL if full
+ */
+void *
+ringbuffer_spsc_reserve(rb_spsc_t *ctx, size_t *len);
+
+/**
+ * @brief Publish elements written into a reserved region (producer)
+ *
+ * @param ctx Ringbuffer context
+ * @param len Elements to publish (<= granted)
+ */
+void
+ringbuffer_spsc_commit(rb_spsc_t *ctx, size_t len);
+
+/**
+ * @brief Pop data from ringbuffer (consumer)
+ *
+ * @param ctx Ringbuffer context
+ * @param data Buffer to store data
+ * @param len Length of data
+ * @return size_t Elements popped
+ */
+size_t
+ringbuffer_spsc_pop(rb_spsc_t *ctx, void *data, size_t len);
+
+/**
+ * @brief Read data w/o removing (consumer)
+ *
+ * @param ctx Ringbuffer context
+ * @param data Buffer to store data
+ * @param len Length of data
+ * @return size_t Elements read
+ */
+size_t
+ringbuffer_spsc_peek(rb_spsc_t *ctx, void *data, size_t len);
+
+/**
+ * @brief Get readable data in place as up to two contiguous segments (consumer)
+ *
+ * @param ctx Ringbuffer context
+ * @param seg0 First segment (starts at tail)
+ * @param len0 First segment length
+ * @param seg1 Second segment (starts at buffer start)
+ * @param len1 Second segment length
+ * @return size_t Total elements readable
+ */
+size_t
+ringbuffer_spsc_segments(rb_spsc_t *ctx, const void **seg0, size_t *len0, const void **seg1, size_t *len1);
+
+/**
+ * @brief Release elements without reading (consumer)
+ *
+ * @param ctx Ringbuffer context
+ * @param len Length of data
+ * @return size_t Elements released
+ */
+size_t
+ringbuffer_spsc_seek(rb_spsc_t *ctx, size_t len);
+
+/**
+ * @brief Drop all readable data (consumer)
+ *
+ * @param ctx Ringbuffer context
+ * @return size_t Elements dropped
+ */
+size_t
+ringbuffer_spsc_flush(rb_spsc_t *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __RINGBUFFER_SPSC_H
@@ -0,0 +1,86 @@
+/**
+ * @file tio_crc.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio CRC16 and CRC32 engines
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __TIO_CRC_H
+#define __TIO_CRC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// CRC16-CCITT (poly 0x1021, MSB first, no final XOR) seeded w/ 0xEF4A
+#define TIO_CRC16_SEED 0xEF4A
+
+// CRC32 (IEEE 802.3, reflected poly 0xEDB88320), as zlib's crc32()
+#define TIO_CRC32_SEED 0
+
+// Implementation variants (flash usage in parentheses)
+#define TIO_CRC_IMPL_BITWISE 0 // Bit-serial (0 B)
+#define TIO_CRC_IMPL_TABLE 1   // Byte-wise w/ 256-entry table (512 B)
+#define TIO_CRC_IMPL_SLICE4 2  // Slice-by-4 (2 KB)
+#define TIO_CRC_IMPL_SLICE8 3  // Slice-by-8 (4 KB)
+
+#ifndef TIO_CRC_IMPL
+#define TIO_CRC_IMPL TIO_CRC_IMPL_SLICE4
+#endif
+
+/**
+ * @brief Continue CRC16 computation over more data
+ *
+ * @param crc Running CRC (TIO_CRC16_SEED for first chunk)
+ * @param data Data
+ * @param length Data length
+ * @return uint16_t
+ */
+uint16_t
+tio_crc16_update(uint16_t crc, const uint8_t *data, uint32_t length);
+
+/**
+ * @brief Compute CRC16 over data
+ *
+ * @param data Data
+ * @param length Data length
+ * @return uint16_t
+ */
+uint16_t
+tio_crc16(const uint8_t *data, uint32_t length);
+
+/**
+ * @brief Copy data and continue CRC16 over it in a single pass
+ *
+ * @param crc Running CRC
+ * @param dst Destination
+ * @param src Source
+ * @param length Data length
+ * @return uint16_t
+ */
+uint16_t
+tio_crc16_copy(uint16_t crc, uint8_t *dst, const uint8_t *src, uint32_t length);
+
+/**
+ * @brief Continue CRC32 computation over more data
+ *
+ * Uses a 256-entry table (1 KB) unless TIO_CRC_IMPL is bitwise.
+ *
+ * @param crc Running CRC (TIO_CRC32_SEED for first chunk)
+ * @param data Data
+ * @param length Data length
+ * @return uint32_t
+ */
+uint32_t
+tio_crc32_update(uint32_t crc, const uint8_t *data, uint32_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __TIO_CRC_H
@@ -9,35 +9,29 @@
  *
  */
 
-#include "ns_ambiqsuite_harness.h"
-#include "arm_math.h"
-
-#include "ns_usb.h"
-#include "vendor_device.h"
-#include "usb_descriptors.h"
-
-#include "ringbuffer.h"
-#include "tio_usb.h"
+#include <stdatomic.h>
+#include "ringbuffer_spsc.h"
+#include "tio_codec.h"
+#include "tio_crc.h"
+#include "tio_usb_priv.h"
 
 #define TIO_USB_VENDOR_ID 0xCAFE
 #define TIO_USB_PRODUCT_ID 0x0001
-#define TIO_USB_START_IDX 0
-#define TIO_USB_START_VAL 0x55
-#define TIO_USB_SLOT_IDX 1
-#define TIO_USB_TYPE_IDX 2
-#define TIO_USB_DLEN_IDX 3
-#define TIO_USB_DLEN_LEN 2
-#define TIO_USB_DATA_IDX 5
-#define TIO_USB_DATA_LEN 248
-#define TIO_USB_CRC_IDX 253
-#define TIO_USB_CRC_LEN 2
-#define TIO_USB_STOP_IDX 255
-#define TIO_USB_STOP_VAL 0xAA
-#define TIO_USB_UIO_BUF_LEN (8)
+#define TIO_USB_CTRL_HELLO 0x01
+#define TIO_USB_CTRL_PING 0x02
+#define TIO_USB_PING_LEN 10
+#define TIO_USB_PONG_LEN 14
+#define TIO_USB_CAPS_SUPPORTED \
+    (TIO_USB_CAP_COMPACT | TIO_USB_CAP_FRAGMENT | TIO_USB_CAP_SEQ | TIO_USB_CAP_CODEC | TIO_USB_CAP_BULK | \
+     TIO_USB_CAP_TIMESTAMP | TIO_USB_CAP_RATE)
 
 #define TIO_USB_RX_BUFSIZE (4096)
 #define TIO_USB_TX_BUFSIZE (4096)
 
+#if TIO_USB_BULK_WINDOW * TIO_USB_PACKET_LEN >= TIO_USB_RX_BUFSIZE
+#error "TIO_USB_BULK_WINDOW frames don't fit the RX ring"
+#endif
+
 static uint8_t tioDeviceId[6];
 static char tioSerialId[13];
 
@@ -46,7 +40,7 @@ static uint8_t tioRxBuffer[TIO_USB_RX_BUFSIZE] = {0};
 static uint8_t tioTxBuffer[TIO_USB_TX_BUFSIZE] = {0};
 
 static uint8_t tioRxRingBufferData[TIO_USB_RX_BUFSIZE];
-static rb_config_t tioRxRingBuffer = {
+static rb_spsc_t tioRxRingBuffer = {
     .buffer = (void *)tioRxRingBufferData,
     .dlen = sizeof(uint8_t),
     .size = TIO_USB_RX_BUFSIZE,
@@ -54,6 +48,19 @@ static rb_config_t tioRxRingBuffer = {
     .tail = 0,
 };
 
+tio_usb_context_t *gTioUsbCtx = NULL;
+volatile uint16_t tioUsbCaps = 0;
+
+// RX counters are only written by the frame parser, overflows by the producer
+static tio_usb_stats_t tioUsbStats;
+tio_usb_perf_t tioUsbPerf;
+static _Atomic uint8_t tioUsbTxSeq[TIO_USB_SLOTS];
+static uint8_t tioUsbRxSeq[TIO_USB_SLOTS];
+static bool tioUsbRxSeqValid[TIO_USB_SLOTS];
+// W/o deferred_rx the receive callback and tio_usb_service() both parse, one at a time
+static atomic_flag tioRxBusy = ATOMIC_FLAG_INIT;
+static atomic_bool tioRxPending = false; // Frames left by a budgeted or skipped inline pass
+
 static usb_handle_t tioUsbHandle = NULL;
 static ns_usb_config_t tioWebUsbConfig = {
     .api = &ns_usb_V1_0_0,
@@ -67,6 +74,27 @@ static ns_usb_config_t tioWebUsbConfig = {
     .service_cb = NULL};
 
 
+/**
+ * @brief Read the cycles_cb counter if perf counting is enabled
+ */
+static inline uint32_t
+tio_usb_perf_start(void)
+{
+    return gTioUsbCtx && gTioUsbCtx->cycles_cb ? gTioUsbCtx->cycles_cb() : 0;
+}
+
+/**
+ * @brief Add cycles since start to a perf counter
+ */
+static inline void
+tio_usb_perf_stop(uint64_t *cycles, uint32_t start)
+{
+    if (gTioUsbCtx && gTioUsbCtx->cycles_cb)
+    {
+        *cycles += gTioUsbCtx->cycles_cb() - start;
+    }
+}
+
 /**
  * @brief Get the device ID
  *
@@ -111,43 +139,6 @@ tio_device_id_to_serial_id(uint8_t *deviceId, char *serialId, size_t len)
     }
 }
 
-/**
- * @brief Compute CRC16 on packet data
- *
- * @param data Packet data
- * @param length Packet length
- * @return uint16_t
- */
-static uint16_t
-tio_compute_crc16(const uint8_t *data, uint32_t length)
-{
-    uint32_t m_crcStart = 0xEF4A;
-    uint32_t crc = m_crcStart;
-    uint32_t j;
-    uint32_t i;
-    uint32_t byte;
-    uint32_t temp;
-    const uint32_t andValue = 0x8000U;
-    const uint32_t xorValue = 0x1021U;
-
-    for (j = 0; j < length; ++j)
-    {
-        byte = data[j];
-        crc ^= byte << 8;
-        for (i = 0; i < 8U; ++i)
-        {
-            temp = crc << 1;
-            if (0UL != (crc & andValue))
-            {
-                temp ^= xorValue;
-            }
-            crc = temp;
-        }
-    }
-
-    return (uint16_t)crc;
-}
-
 /**
  * @brief Validate the USB packet is correct
  *
@@ -159,95 +150,354 @@ static uint32_t
 tio_usb_validate_packet(const uint8_t *packet, uint32_t length)
 {
     // Decode the packet
-    if (length != TIO_USB_PACKET_LEN)
+    if (length < TIO_USB_HDR_LEN + TIO_USB_TRAILER_LEN || length > TIO_USB_PACKET_LEN)
     {
-        ns_lp_printf("Invalid packet length\n");
+        tioUsbStats.framing_errors++;
         return 1;
     }
     uint8_t start = packet[TIO_USB_START_IDX];
-    uint8_t slot = packet[TIO_USB_SLOT_IDX];
     uint8_t slotType = packet[TIO_USB_TYPE_IDX];
 
     uint16_t dlen = (packet[TIO_USB_DLEN_IDX + 1] << 8) | packet[TIO_USB_DLEN_IDX];
-    uint16_t crc = (packet[TIO_USB_CRC_IDX + 1] << 8) | packet[TIO_USB_CRC_IDX];
+    uint16_t crc = (packet[length - TIO_USB_TRAILER_LEN + 1] << 8) | packet[length - TIO_USB_TRAILER_LEN];
 
-    uint16_t stop = packet[TIO_USB_STOP_IDX];
+    uint16_t stop = packet[length - 1];
     if (start != TIO_USB_START_VAL || stop != TIO_USB_STOP_VAL)
     {
-        ns_lp_printf("Invalid start/stop byte %lu %lu\n", start, stop);
+        tioUsbStats.framing_errors++;
         return 1;
     }
-    if (dlen > TIO_USB_DATA_LEN)
+    if (dlen > TIO_USB_DATA_LEN || tio_usb_frame_len_from_hdr(slotType, dlen) != length)
     {
-        ns_lp_printf("Invalid data length %u\n", dlen);
+        tioUsbStats.framing_errors++;
         return 1;
     }
-    uint16_t computedCrc = tio_compute_crc16(packet + TIO_USB_DLEN_IDX, dlen + TIO_USB_DLEN_LEN);
-    if (crc != computedCrc)
+    // Header checks go first, the CRC is the costly part of a bad candidate
+    if ((slotType & TIO_USB_TYPE_MASK) == 2 && dlen != TIO_USB_UIO_BUF_LEN)
     {
-        ns_lp_printf("Invalid CRC %x %x\n", crc, computedCrc);
+        tioUsbStats.framing_errors++;
         return 1;
     }
-    if (slotType <= 1 && dlen > TIO_USB_DATA_LEN)
+    uint32_t crcLen = TIO_USB_DLEN_LEN + dlen + tio_usb_frame_ext_len(slotType);
+    tioUsbPerf.parse_crc_bytes += crcLen;
+    if (crc != tio_crc16(packet + TIO_USB_DLEN_IDX, crcLen))
     {
-        ns_lp_printf("Invalid data length for slot type %lu\n", slotType);
+        tioUsbStats.crc_errors++;
         return 1;
     }
-    if (slotType == 2 && dlen != TIO_USB_UIO_BUF_LEN)
+    return 0;
+}
+
+/**
+ * @brief Handle control frame from host
+ *
+ * @param data Control payload
+ * @param length Payload length
+ */
+static void
+tio_usb_handle_ctrl(const uint8_t *data, uint32_t length)
+{
+    if (length >= 4 && data[0] == TIO_USB_CTRL_HELLO)
+    {
+        uint16_t caps = ((data[3] << 8) | data[2]) & TIO_USB_CAPS_SUPPORTED;
+        if (!(caps & TIO_USB_CAP_COMPACT))
+        {
+            caps &= ~(TIO_USB_CAP_SEQ | TIO_USB_CAP_TIMESTAMP);
+        }
+        if (gTioUsbCtx->tick_us_cb == NULL)
+        {
+            caps &= ~TIO_USB_CAP_TIMESTAMP;
+        }
+        uint8_t reply[4] = {TIO_USB_CTRL_HELLO, TIO_USB_PROTOCOL_VERSION, caps & 0xFF, (caps >> 8) & 0xFF};
+        uint8_t packet[TIO_USB_PACKET_LEN];
+        // Reply w/ fixed framing, then switch to accepted capabilities
+        tioUsbCaps = 0;
+        memset(tioUsbRxSeqValid, 0, sizeof(tioUsbRxSeqValid));
+        tio_usb_pack_slot_data(0, TIO_USB_TYPE_CTRL, reply, sizeof(reply), packet);
+        tio_usb_tx_post_ctrl(packet, TIO_USB_PACKET_LEN);
+        tioUsbCaps = caps;
+    }
+    else if (length >= TIO_USB_PING_LEN && data[0] == TIO_USB_CTRL_PING && gTioUsbCtx->tick_us_cb)
     {
-        ns_lp_printf("Invalid data length for UIO\n");
-        return 1;
+        // Echo id and host time, add device time
+        uint32_t now = gTioUsbCtx->tick_us_cb();
+        uint8_t reply[TIO_USB_PONG_LEN];
+        uint8_t packet[TIO_USB_PACKET_LEN];
+        memcpy(reply, data, TIO_USB_PING_LEN);
+        reply[10] = now & 0xFF;
+        reply[11] = (now >> 8) & 0xFF;
+        reply[12] = (now >> 16) & 0xFF;
+        reply[13] = (now >> 24) & 0xFF;
+        tio_usb_pack_slot_data(0, TIO_USB_TYPE_CTRL, reply, sizeof(reply), packet);
+        tio_usb_tx_post_ctrl(packet, TIO_USB_PACKET_LEN);
     }
-    return 0;
 }
 
 /**
- * @brief Callback for USB receive
+ * @brief Count frames missing from a slot's sequence, and ones repeated or
+ * arriving late w/o moving it back
  *
- * @param buffer Rx buffer
- * @param length Buffer length
- * @param args Tileio USB context
+ * @param slot Slot number
+ * @param seq Received sequence number
  */
 static void
-tio_usb_receive_handler(const uint8_t *buffer, uint32_t length, void *args)
+tio_usb_track_seq(uint8_t slot, uint8_t seq)
+{
+    if (slot >= TIO_USB_SLOTS)
+    {
+        return;
+    }
+    if (tioUsbRxSeqValid[slot])
+    {
+        int8_t d = (int8_t)(seq - tioUsbRxSeq[slot]);
+        if (d < 0)
+        {
+            tioUsbStats.seq_repeats++;
+            return;
+        }
+        tioUsbStats.seq_gaps += d;
+    }
+    tioUsbRxSeq[slot] = seq + 1;
+    tioUsbRxSeqValid[slot] = true;
+}
+
+/**
+ * @brief Consume bytes from the RX ring
+ *
+ * @param len Byte count
+ */
+static inline void
+tio_usb_rx_seek(size_t len)
+{
+    ringbuffer_spsc_seek(&tioRxRingBuffer, len);
+    tioUsbPerf.parse_bytes += len;
+}
+
+/**
+ * @brief Read byte at offset from a pair of ring segments
+ */
+static inline uint8_t
+tio_usb_rx_byte(const uint8_t *seg0, size_t len0, const uint8_t *seg1, size_t idx)
+{
+    return idx < len0 ? seg0[idx] : seg1[idx - len0];
+}
+
+/**
+ * @brief Parse and dispatch all complete frames in the RX ring
+ *
+ * @param ctx Tileio USB context
+ * @return uint32_t Number of frames dispatched
+ */
+static uint32_t
+tio_usb_process_rx(tio_usb_context_t *ctx)
 {
-    tio_usb_context_t *ctx = (tio_usb_context_t *)args;
-    ringbuffer_push(&tioRxRingBuffer, (void *)buffer, length);
     uint8_t slotFrame[TIO_USB_PACKET_LEN];
-    uint32_t skip = 0;
-    while (ringbuffer_len(&tioRxRingBuffer) >= TIO_USB_PACKET_LEN)
+    const uint8_t *seg0, *seg1;
+    size_t len0, len1;
+    uint32_t frames = 0;
+    uint32_t crcStart = tioUsbPerf.parse_crc_bytes;
+    uint32_t perfStart = tio_usb_perf_start();
+    while (ringbuffer_spsc_segments(&tioRxRingBuffer, (const void **)&seg0, &len0, (const void **)&seg1, &len1))
     {
-        ringbuffer_peek(&tioRxRingBuffer, slotFrame, TIO_USB_PACKET_LEN);
-        skip = tio_usb_validate_packet(slotFrame, TIO_USB_PACKET_LEN);
-        if (skip)
+        // Discard everything up to the next start byte
+        if (seg0[TIO_USB_START_IDX] != TIO_USB_START_VAL)
+        {
+            const uint8_t *start = memchr(seg0, TIO_USB_START_VAL, len0);
+            size_t skip = start ? (size_t)(start - seg0) : len0;
+            tioUsbStats.resync_bytes += skip;
+            tio_usb_rx_seek(skip);
+            continue;
+        }
+        if (len0 + len1 < TIO_USB_HDR_LEN)
+        {
+            break;
+        }
+        uint8_t slotType = tio_usb_rx_byte(seg0, len0, seg1, TIO_USB_TYPE_IDX);
+        uint16_t length = (tio_usb_rx_byte(seg0, len0, seg1, TIO_USB_DLEN_IDX + 1) << 8) |
+                          tio_usb_rx_byte(seg0, len0, seg1, TIO_USB_DLEN_IDX);
+        uint32_t frameLen = tio_usb_frame_len_from_hdr(slotType, length);
+        if (length > TIO_USB_DATA_LEN || frameLen > TIO_USB_PACKET_LEN)
         {
-            ringbuffer_seek(&tioRxRingBuffer, 1);
+            tioUsbStats.framing_errors++;
+            tioUsbStats.resync_bytes++;
+            tio_usb_rx_seek(1);
+            continue;
+        }
+        if (len0 + len1 < frameLen)
+        {
+            break;
+        }
+        // Cheap stop byte check before paying for a CRC
+        if (tio_usb_rx_byte(seg0, len0, seg1, frameLen - 1) != TIO_USB_STOP_VAL)
+        {
+            tioUsbStats.framing_errors++;
+            tioUsbStats.resync_bytes++;
+            tio_usb_rx_seek(1);
+            continue;
+        }
+        // Bound CRC work per pass, the rest waits for the next service call
+        if (ctx->rx_crc_budget && tioUsbPerf.parse_crc_bytes - crcStart >= ctx->rx_crc_budget)
+        {
+            tioUsbPerf.parse_budget_hits++;
+            break;
+        }
+        // Validate in place unless the frame straddles the wrap point
+        const uint8_t *frame = seg0;
+        if (len0 < frameLen)
+        {
+            memcpy(slotFrame, seg0, len0);
+            memcpy(slotFrame + len0, seg1, frameLen - len0);
+            frame = slotFrame;
+        }
+        if (tio_usb_validate_packet(frame, frameLen))
+        {
+            tioUsbStats.resync_bytes++;
+            tio_usb_rx_seek(1);
             continue;
         }
         // If valid, parse the slot frame and send it to the appropriate slot
-        uint8_t slot = slotFrame[TIO_USB_SLOT_IDX];
-        uint8_t slotType = slotFrame[TIO_USB_TYPE_IDX];
-        uint16_t length = (slotFrame[TIO_USB_DLEN_IDX + 1] << 8) | slotFrame[TIO_USB_DLEN_IDX];
+        uint8_t slot = frame[TIO_USB_SLOT_IDX] & TIO_USB_SLOT_MASK;
+        tioUsbStats.rx_frames++;
+        if (tio_usb_frame_has_seq(slotType) && (slotType & TIO_USB_TYPE_MASK) < TIO_USB_TYPE_CTRL)
+        {
+            tio_usb_track_seq(slot, frame[TIO_USB_DATA_IDX + length + (tio_usb_frame_has_ts(slotType) ? TIO_USB_TS_LEN : 0)]);
+        }
+        uint8_t flags = slotType;
+        slotType &= TIO_USB_TYPE_MASK;
+        // Encoded samples are only sent, never received
+        if (flags & TIO_USB_FLAG_CODEC)
+        {
+            tioUsbStats.framing_errors++;
+        }
+        // Piece of a larger slot message
+        else if (flags & TIO_USB_FLAG_FRAGMENT)
+        {
+            if (tio_slot_valid(slot, slotType))
+            {
+                tio_usb_reasm_frame(ctx, slot, slotType, frame + TIO_USB_DATA_IDX, length);
+            }
+        }
         // Slot signal or metrics
-        if (slotType <= 1 && ctx->slot_update_cb != NULL)
+        else if (tio_slot_valid(slot, slotType) && ctx->slot_update_cb != NULL)
         {
-            ctx->slot_update_cb(slot, slotType, slotFrame + TIO_USB_DATA_IDX, length);
+            ctx->slot_update_cb(slot, slotType, frame + TIO_USB_DATA_IDX, length);
         }
         // Slot UIO
         else if (slotType == 2 && ctx->uio_update_cb != NULL)
         {
-            ctx->uio_update_cb(slotFrame + TIO_USB_DATA_IDX, length);
+            ctx->uio_update_cb(frame + TIO_USB_DATA_IDX, length);
+        }
+        // Link control
+        else if (slotType == TIO_USB_TYPE_CTRL)
+        {
+            tio_usb_handle_ctrl(frame + TIO_USB_DATA_IDX, length);
+        }
+        // Bulk downlink
+        else if (slotType == TIO_USB_TYPE_BULK)
+        {
+            tio_usb_bulk_frame(ctx, frame + TIO_USB_DATA_IDX, length);
         }
-        ringbuffer_seek(&tioRxRingBuffer, TIO_USB_PACKET_LEN);
+        tio_usb_rx_seek(frameLen);
+        frames++;
+    }
+    if (ctx->cycles_cb)
+    {
+        uint32_t cycles = ctx->cycles_cb() - perfStart;
+        tioUsbPerf.parse_cycles += cycles;
+        tioUsbPerf.parse_max_cycles = cycles > tioUsbPerf.parse_max_cycles ? cycles : tioUsbPerf.parse_max_cycles;
+    }
+    tioUsbPerf.parse_frames += frames;
+    return frames;
+}
+
+/**
+ * @brief Parse received frames w/o deferred_rx
+ *
+ * Frames a budgeted pass left behind, or that arrived while the other
+ * caller was parsing, are picked up by the next tio_usb_service() rather
+ * than waiting for more data from the host.
+ *
+ * @param ctx Tileio USB context
+ * @return uint32_t Number of frames dispatched
+ */
+static uint32_t
+tio_usb_process_rx_inline(tio_usb_context_t *ctx)
+{
+    if (atomic_flag_test_and_set(&tioRxBusy))
+    {
+        atomic_store(&tioRxPending, true);
+        return 0;
+    }
+    atomic_store(&tioRxPending, false);
+    uint32_t hits = tioUsbPerf.parse_budget_hits;
+    tio_usb_reasm_poll(ctx);
+    uint32_t frames = tio_usb_process_rx(ctx);
+    if (tioUsbPerf.parse_budget_hits != hits)
+    {
+        atomic_store(&tioRxPending, true);
+    }
+    atomic_flag_clear(&tioRxBusy);
+    return frames;
+}
+
+/**
+ * @brief Callback for USB receive
+ *
+ * @param buffer Rx buffer
+ * @param length Buffer length
+ * @param args Tileio USB context
+ */
+static void
+tio_usb_receive_handler(const uint8_t *buffer, uint32_t length, void *args)
+{
+    tio_usb_context_t *ctx = (tio_usb_context_t *)args;
+    // Only the producer side of the RX ring is touched when parsing is deferred
+    size_t pushed = ringbuffer_spsc_push(&tioRxRingBuffer, buffer, length);
+    if (pushed < length)
+    {
+        tioUsbStats.rx_overflows += length - pushed;
+    }
+    uint32_t queued = ringbuffer_spsc_len(&tioRxRingBuffer);
+    if (queued > tioUsbPerf.rx_ring_max)
+    {
+        tioUsbPerf.rx_ring_max = queued;
+    }
+    if (!ctx->deferred_rx)
+    {
+        tio_usb_process_rx_inline(ctx);
     }
 }
 
+/**
+ * @brief Drain pending TX and, w/ deferred_rx, parse received frames and
+ * invoke callbacks from caller's context (w/o it, only what an inline
+ * pass left behind)
+ *
+ * @return uint32_t Number of frames dispatched
+ */
+uint32_t
+tio_usb_service(void)
+{
+    if (gTioUsbCtx == NULL)
+    {
+        return 0;
+    }
+    tio_usb_tx_service();
+    if (!gTioUsbCtx->deferred_rx)
+    {
+        return atomic_load(&tioRxPending) ? tio_usb_process_rx_inline(gTioUsbCtx) : 0;
+    }
+    tio_usb_reasm_poll(gTioUsbCtx);
+    return tio_usb_process_rx(gTioUsbCtx);
+}
+
 /**
  * @brief Pack slot data into USB frame
- * @param slot Slot number (0-3)
+ * @param slot Slot number (0 - TIO_SLOTS-1)
  * @param slot_type Slot type (0 - signal, 1 - metric, 2 - uio)
- * @param data Slot data (max 240 bytes)
+ * @param data Slot data (max 248 bytes)
  * @param length Data length
+ * @param packet Frame buffer (TIO_USB_PACKET_LEN bytes)
  * @return uint32_t
  */
 uint32_t
@@ -258,90 +508,242 @@ tio_usb_pack_slot_data(uint8_t slot, uint8_t slot_type, const uint8_t *data, uin
         ns_lp_printf("Data length exceeds limit\n");
         return 1;
     }
-    memset(packet, 0, TIO_USB_PACKET_LEN);
+    uint8_t flags = tio_usb_tx_flags();
     packet[TIO_USB_START_IDX] = TIO_USB_START_VAL;
     packet[TIO_USB_SLOT_IDX] = slot;
-    packet[TIO_USB_TYPE_IDX] = slot_type;
+    packet[TIO_USB_TYPE_IDX] = slot_type | flags;
     packet[TIO_USB_DLEN_IDX] = length & 0xFF;
     packet[TIO_USB_DLEN_IDX + 1] = (length >> 8) & 0xFF;
-    memcpy(packet + TIO_USB_DATA_IDX, data, length);
-    // CRC on data length and data
-    uint16_t crc = tio_compute_crc16(packet + TIO_USB_DLEN_IDX, length + TIO_USB_DLEN_LEN);
-    packet[TIO_USB_CRC_IDX] = crc & 0xFF;
-    packet[TIO_USB_CRC_IDX + 1] = (crc >> 8) & 0xFF;
-    packet[TIO_USB_STOP_IDX] = TIO_USB_STOP_VAL;
+    // CRC on data length and data, computed while copying
+    uint16_t crc = tio_crc16(packet + TIO_USB_DLEN_IDX, TIO_USB_DLEN_LEN);
+    crc = tio_crc16_copy(crc, packet + TIO_USB_DATA_IDX, data, length);
+    // Fixed frames zero the unused DATA field
+    if (!flags)
+    {
+        memset(packet + TIO_USB_DATA_IDX + length, 0, TIO_USB_DATA_LEN - length);
+    }
+    tio_usb_frame_finish(packet, length, crc);
     return 0;
 }
 
 /**
- * @brief Check if USB is mounted and has space to send a packet
- * @return uint32_t
+ * @brief Get length of a packed USB frame from its header
+ *
+ * @param packet USB packet
+ * @return uint32_t Frame length or 0 if header is invalid
  */
 uint32_t
-tio_usb_tx_available()
+tio_usb_frame_len(const uint8_t *packet)
 {
-    if (!tud_vendor_mounted()) {
+    uint32_t dlen = (packet[TIO_USB_DLEN_IDX + 1] << 8) | packet[TIO_USB_DLEN_IDX];
+    uint32_t frameLen = tio_usb_frame_len_from_hdr(packet[TIO_USB_TYPE_IDX], dlen);
+    if (packet[TIO_USB_START_IDX] != TIO_USB_START_VAL || dlen > TIO_USB_DATA_LEN || frameLen > TIO_USB_PACKET_LEN)
+    {
         return 0;
     }
-    if (tud_vendor_write_available() < TIO_USB_PACKET_LEN) {
-        return 0;
+    return frameLen;
+}
+
+/**
+ * @brief Get capabilities negotiated w/ host
+ *
+ * @return uint16_t TIO_USB_CAP_* flags
+ */
+uint16_t
+tio_usb_get_caps(void)
+{
+    return tioUsbCaps;
+}
+
+uint8_t
+tio_usb_next_seq(uint8_t slot)
+{
+    return slot < TIO_USB_SLOTS ? atomic_fetch_add_explicit(&tioUsbTxSeq[slot], 1, memory_order_relaxed) : 0;
+}
+
+/**
+ * @brief Get hot path timing and high-water marks
+ *
+ * @param perf Counters (timing only w/ a cycles_cb)
+ */
+void
+tio_usb_get_perf(tio_usb_perf_t *perf)
+{
+    *perf = tioUsbPerf;
+}
+
+/**
+ * @brief Get link quality counters
+ *
+ * @param stats Counters
+ */
+void
+tio_usb_get_stats(tio_usb_stats_t *stats)
+{
+    tio_usb_tx_stats_t txStats;
+    tio_usb_get_tx_stats(&txStats);
+    *stats = tioUsbStats;
+    stats->tx_frames = 0;
+    stats->tx_busy = 0;
+    for (uint32_t lane = 0; lane < TIO_USB_TX_LANES; lane++)
+    {
+        stats->tx_frames += txStats.lanes[lane].sent;
+        stats->tx_busy += txStats.lanes[lane].dropped;
     }
-    return 1;
 }
 
 /**
- * @brief Send packet buffer over USB
+ * @brief Encode samples and send them as one or more codec frames
  *
- * @param packet USB packet
- * @param length Packet length
+ * @param slot Slot number
+ * @param codec Codec ID
+ * @param samples Samples
+ * @param count Number of samples
  * @return uint32_t
  */
-uint32_t
-tio_usb_send_slot_packet(uint8_t *packet, uint32_t length)
+static uint32_t
+tio_usb_send_slot_encoded(uint8_t slot, uint8_t codec, const int16_t *samples, uint32_t count)
 {
-    if (length != TIO_USB_PACKET_LEN)
+    uint32_t frames = tio_codec_max_blocks(codec, count, TIO_USB_DATA_LEN);
+    if (count && frames == 0)
     {
-        ns_lp_printf("Invalid packet length\n");
+        ns_lp_printf("Invalid slot codec\n");
         return 1;
     }
-    if (!tio_usb_tx_available()) {
+    // All or nothing, the host can't use part of the samples
+    if (tio_usb_tx_room(0, frames))
+    {
         return 1;
     }
-    webusb_send_data(packet, 256);
+    uint8_t local[TIO_USB_PACKET_LEN];
+    while (count)
+    {
+        uint8_t *frame = tio_usb_frame_reserve_local(slot, 0, local);
+        if (frame == NULL)
+        {
+            return 1;
+        }
+        frame[TIO_USB_TYPE_IDX - TIO_USB_DATA_IDX] |= TIO_USB_FLAG_CODEC;
+        uint32_t encoded;
+        uint32_t dlen = tio_codec_encode(codec, samples, count, frame, TIO_USB_DATA_LEN, &encoded);
+        if (dlen == 0)
+        {
+            ns_lp_printf("Invalid slot codec\n");
+            tio_usb_frame_cancel(frame);
+            return 1;
+        }
+        if (tio_usb_frame_commit_len(frame, dlen))
+        {
+            return 1;
+        }
+        samples += encoded;
+        count -= encoded;
+    }
     return 0;
 }
 
+/**
+ * @brief Send blocks encoded by the core as codec frames
+ *
+ * @param slot Slot number
+ * @param blocks Encoded blocks back to back
+ * @param blockLens Block lengths
+ * @param numBlocks Number of blocks
+ * @return uint32_t
+ */
+static uint32_t
+tio_usb_send_slot_blocks(uint8_t slot, const uint8_t *blocks, const uint16_t *blockLens, uint32_t numBlocks)
+{
+    for (uint32_t i = 0; i < numBlocks; i++)
+    {
+        if (blockLens[i] > TIO_USB_DATA_LEN)
+        {
+            return 1;
+        }
+    }
+    // All or nothing, like the encoded path
+    if (tio_usb_tx_room(0, numBlocks))
+    {
+        return 1;
+    }
+    uint8_t local[TIO_USB_PACKET_LEN];
+    for (uint32_t i = 0; i < numBlocks; i++)
+    {
+        uint8_t *frame = tio_usb_frame_reserve_local(slot, 0, local);
+        if (frame == NULL)
+        {
+            return 1;
+        }
+        frame[TIO_USB_TYPE_IDX - TIO_USB_DATA_IDX] |= TIO_USB_FLAG_CODEC;
+        memcpy(frame, blocks, blockLens[i]);
+        if (tio_usb_frame_commit_len(frame, blockLens[i]))
+        {
+            return 1;
+        }
+        blocks += blockLens[i];
+    }
+    return 0;
+}
+
+/**
+ * @brief Send raw slot data as one frame or fragments
+ */
+static uint32_t
+tio_usb_send_slot_raw(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length)
+{
+    if (length > TIO_USB_DATA_LEN && (tioUsbCaps & TIO_USB_CAP_FRAGMENT) && slot_type <= 1)
+    {
+        return tio_usb_send_slot_message(slot, slot_type, data, length);
+    }
+    if (length > TIO_USB_DATA_LEN)
+    {
+        ns_lp_printf("Data length exceeds limit\n");
+        return 1;
+    }
+    // Copy straight into the TX stage, CRC computed on the way
+    uint8_t local[TIO_USB_PACKET_LEN];
+    uint8_t *frame = tio_usb_frame_reserve_local(slot, slot_type, local);
+    if (frame == NULL)
+    {
+        return 1;
+    }
+    uint8_t dlen[TIO_USB_DLEN_LEN] = {length & 0xFF, (length >> 8) & 0xFF};
+    memcpy(frame - TIO_USB_DATA_IDX + TIO_USB_DLEN_IDX, dlen, TIO_USB_DLEN_LEN);
+    uint16_t crc = tio_crc16(dlen, TIO_USB_DLEN_LEN);
+    crc = tio_crc16_copy(crc, frame, data, length);
+    return tio_usb_frame_commit_crc(frame, length, crc);
+}
 
 /**
  * @brief Pack and send slot data
- * @param slot Slot number (0-3)
+ * @param slot Slot number (0 - TIO_SLOTS-1)
  * @param slot_type Slot type (0 - signal, 1 - metric, 2 - uio)
- * @param data Slot data (max 240 bytes)
+ * @param data Slot data (max 248 bytes, or fragmented if host enabled TIO_USB_CAP_FRAGMENT; int16
+ *             samples, so an even length, for slots w/ a codec)
  * @param length Data length
  * @return uint32_t
  */
 uint32_t
 tio_usb_send_slot_data(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length)
 {
-    if (length > TIO_USB_DATA_LEN)
+    uint32_t start = tio_usb_perf_start();
+    uint32_t rst;
+    if (slot_type == 0 && slot < TIO_USB_SLOTS && gTioUsbCtx->codec[slot] != TIO_CODEC_NONE &&
+        (tioUsbCaps & TIO_USB_CAP_CODEC))
     {
-        ns_lp_printf("Data length exceeds limit\n");
-        return 1;
+        if (length & 1)
+        {
+            ns_lp_printf("Odd sample data length\n");
+            return 1;
+        }
+        rst = tio_usb_send_slot_encoded(slot, gTioUsbCtx->codec[slot], (const int16_t *)data, length / 2);
+    }
+    else
+    {
+        rst = tio_usb_send_slot_raw(slot, slot_type, data, length);
     }
-    // Send the signal data for given slot
-    uint8_t buffer[TIO_USB_PACKET_LEN] = {0};
-    buffer[TIO_USB_START_IDX] = TIO_USB_START_VAL;
-    buffer[TIO_USB_SLOT_IDX] = slot;
-    buffer[TIO_USB_TYPE_IDX] = slot_type;
-    buffer[TIO_USB_DLEN_IDX] = length & 0xFF;
-    buffer[TIO_USB_DLEN_IDX + 1] = (length >> 8) & 0xFF;
-    memcpy(buffer + TIO_USB_DATA_IDX, data, length);
-    // CRC on data length and data
-    uint16_t crc = tio_compute_crc16(buffer + TIO_USB_DLEN_IDX, length + TIO_USB_DLEN_LEN);
-    buffer[TIO_USB_CRC_IDX] = crc & 0xFF;
-    buffer[TIO_USB_CRC_IDX + 1] = (crc >> 8) & 0xFF;
-    buffer[TIO_USB_STOP_IDX] = TIO_USB_STOP_VAL;
-    return tio_usb_send_slot_packet(buffer, TIO_USB_PACKET_LEN);
+    tio_usb_perf_stop(&tioUsbPerf.pack_cycles, start);
+    return rst;
 }
 
 /**
@@ -355,10 +757,64 @@ uint32_t
 tio_usb_send_uio_state(const uint8_t *data, uint32_t length)
 {
     uint8_t packet[TIO_USB_PACKET_LEN];
-    tio_usb_pack_slot_data(0, 2, data, length, packet);
-    return tio_usb_send_slot_packet(packet, TIO_USB_PACKET_LEN);
+    uint32_t start = tio_usb_perf_start();
+    uint32_t rst = tio_usb_pack_slot_data(0, 2, data, length, packet) ||
+                   tio_usb_send_slot_packet(packet, TIO_USB_PACKET_LEN);
+    tio_usb_perf_stop(&tioUsbPerf.pack_cycles, start);
+    return rst;
+}
+
+static uint32_t
+tio_usb_transport_max_payload(void)
+{
+    return TIO_USB_DATA_LEN;
+}
+
+static uint32_t
+tio_usb_transport_send(const tio_slot_update_t *update)
+{
+    uint32_t start = tio_usb_perf_start();
+    uint32_t rst;
+    uint8_t slot = update->slot;
+    if (update->rate_div > 1 && (tioUsbCaps & TIO_USB_CAP_RATE))
+    {
+        slot |= update->rate_div << TIO_USB_RATE_SHIFT;
+    }
+    // Blocks are only sent once the host accepts codec frames
+    if (update->num_blocks && (tioUsbCaps & TIO_USB_CAP_CODEC))
+    {
+        rst = tio_usb_send_slot_blocks(slot, update->blocks, update->block_lens, update->num_blocks);
+    }
+    else
+    {
+        rst = tio_usb_send_slot_raw(slot, update->slot_type, update->data, update->length);
+    }
+    tio_usb_perf_stop(&tioUsbPerf.pack_cycles, start);
+    return rst;
+}
+
+static uint32_t
+tio_usb_transport_backlog(uint8_t slot)
+{
+    (void)slot;
+    // Signal frames of every slot share the low priority lane
+    return tud_vendor_mounted() ? tio_usb_tx_backlog() : TIO_BACKLOG_IDLE;
+}
+
+static bool
+tio_usb_transport_rate_tag(void)
+{
+    return tioUsbCaps & TIO_USB_CAP_RATE;
 }
 
+const tio_transport_t tioUsbTransport = {
+    .max_payload = tio_usb_transport_max_payload,
+    .send = tio_usb_transport_send,
+    .send_uio = tio_usb_send_uio_state,
+    .backlog = tio_usb_transport_backlog,
+    .rate_tag = tio_usb_transport_rate_tag,
+};
+
 /**
  * @brief Initialize the USB system
  *
@@ -368,6 +824,7 @@ tio_usb_send_uio_state(const uint8_t *data, uint32_t length)
 uint32_t
 tio_usb_init(tio_usb_context_t *ctx)
 {
+    gTioUsbCtx = ctx;
     webusb_register_raw_cb(tio_usb_receive_handler, ctx);
 
     tio_get_device_id(tioDeviceId);
@@ -377,7 +834,16 @@ tio_usb_init(tio_usb_context_t *ctx)
     usb_string_desc_arr[USB_DESCRIPTOR_PRODUCT] = "Tileio";
     usb_string_desc_arr[USB_DESCRIPTOR_SERIAL] = tioSerialId;
 
-    ringbuffer_flush(&tioRxRingBuffer);
+    ringbuffer_spsc_flush(&tioRxRingBuffer);
+    atomic_store(&tioRxPending, false);
+    tioUsbCaps = 0;
+    memset(&tioUsbStats, 0, sizeof(tioUsbStats));
+    memset(&tioUsbPerf, 0, sizeof(tioUsbPerf));
+    memset(tioUsbTxSeq, 0, sizeof(tioUsbTxSeq));
+    memset(tioUsbRxSeqValid, 0, sizeof(tioUsbRxSeqValid));
+    tio_usb_reasm_reset();
+    tio_usb_bulk_reset();
+    tio_usb_tx_init(&tioWebUsbConfig);
 
     // Initialize USB
     if (ns_usb_init(&tioWebUsbConfig, &tioUsbHandle))
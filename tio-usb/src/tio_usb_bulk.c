@@ -0,0 +1,234 @@
+/**
+ * @file tio_usb_bulk.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio USB bulk downlink w/ windowed acknowledgements
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "tio_crc.h"
+#include "tio_usb_priv.h"
+
+#define TIO_USB_BULK_OP_OPEN 0x01
+#define TIO_USB_BULK_OP_DATA 0x02
+#define TIO_USB_BULK_OP_ABORT 0x03
+#define TIO_USB_BULK_OP_ACK 0x04
+
+#define TIO_USB_BULK_OPEN_LEN 10
+#define TIO_USB_BULK_DATA_HDR_LEN 6
+#define TIO_USB_BULK_ACK_LEN 8
+
+typedef struct {
+    bool active;
+    bool opened;      // An object was opened since reset (state, length and objCrc are its)
+    uint8_t window;
+    bool nakSent;     // Expected offset acked since the last in-order frame
+    uint32_t length;
+    uint32_t objCrc;  // CRC32 announced by the host
+    uint32_t crc;     // Running CRC32 of bytes received
+    uint32_t unacked; // In-order frames since the last ACK
+    tio_usb_bulk_state_t state;
+} tio_usb_bulk_t;
+
+static tio_usb_bulk_t tioUsbBulk;
+
+/**
+ * @brief Read a little endian 32-bit field
+ */
+static inline uint32_t
+tio_usb_bulk_u32(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+/**
+ * @brief Send an ACK w/ the next expected offset and current status
+ */
+static void
+tio_usb_bulk_ack(void)
+{
+    tio_usb_bulk_t *b = &tioUsbBulk;
+    uint32_t next = b->state.received;
+    uint8_t ack[TIO_USB_BULK_ACK_LEN] = {
+        TIO_USB_BULK_OP_ACK, b->state.id, b->state.status, b->window,
+        next & 0xFF, (next >> 8) & 0xFF, (next >> 16) & 0xFF, (next >> 24) & 0xFF};
+    uint8_t packet[TIO_USB_PACKET_LEN];
+    b->unacked = 0;
+    tio_usb_pack_slot_data(0, TIO_USB_TYPE_BULK, ack, sizeof(ack), packet);
+    tio_usb_tx_post_ctrl(packet, TIO_USB_PACKET_LEN);
+}
+
+/**
+ * @brief Finish the current object w/ a status
+ */
+static void
+tio_usb_bulk_finish(tio_usb_context_t *ctx, tio_usb_bulk_status_e status)
+{
+    tio_usb_bulk_t *b = &tioUsbBulk;
+    b->active = false;
+    b->state.status = status;
+    if (ctx->bulk.done_cb != NULL)
+    {
+        ctx->bulk.done_cb(b->state.id, b->state.length, status);
+    }
+}
+
+/**
+ * @brief Start (or resume) an object
+ */
+static void
+tio_usb_bulk_open(tio_usb_context_t *ctx, const uint8_t *data, uint32_t length)
+{
+    tio_usb_bulk_t *b = &tioUsbBulk;
+    if (length < TIO_USB_BULK_OPEN_LEN)
+    {
+        return;
+    }
+    uint8_t id = data[1];
+    uint32_t objLen = tio_usb_bulk_u32(data + 2);
+    uint32_t objCrc = tio_usb_bulk_u32(data + 6);
+    uint32_t window = ctx->bulk.window;
+    b->window = window && window < TIO_USB_BULK_WINDOW ? window : TIO_USB_BULK_WINDOW;
+    b->nakSent = false;
+    // Same object again picks up where it left off (or just gets the final
+    // ACK again if it already arrived)
+    if (b->opened && (b->active || b->state.status == TIO_USB_BULK_OK) && b->state.id == id &&
+        b->length == objLen && b->objCrc == objCrc)
+    {
+        tio_usb_bulk_ack();
+        return;
+    }
+    if (b->active)
+    {
+        tio_usb_bulk_finish(ctx, TIO_USB_BULK_ABORTED);
+    }
+    uint32_t rejected = b->state.rejected;
+    memset(&b->state, 0, sizeof(b->state));
+    b->state.id = id;
+    b->state.length = objLen;
+    b->state.rejected = rejected;
+    b->length = objLen;
+    b->objCrc = objCrc;
+    b->crc = TIO_CRC32_SEED;
+    b->unacked = 0;
+    b->active = true;
+    b->opened = true;
+    b->state.status = TIO_USB_BULK_IN_PROGRESS;
+    if (ctx->bulk.buffer == NULL && ctx->bulk.sink_cb == NULL)
+    {
+        tio_usb_bulk_finish(ctx, TIO_USB_BULK_NO_SINK);
+    }
+    else if (ctx->bulk.buffer != NULL && objLen > ctx->bulk.buffer_len)
+    {
+        tio_usb_bulk_finish(ctx, TIO_USB_BULK_TOO_LARGE);
+    }
+    else if (objLen == 0)
+    {
+        tio_usb_bulk_finish(ctx, objCrc == TIO_CRC32_SEED ? TIO_USB_BULK_OK : TIO_USB_BULK_CRC_ERROR);
+    }
+    tio_usb_bulk_ack();
+}
+
+/**
+ * @brief Take a DATA frame if it continues the object in order
+ */
+static void
+tio_usb_bulk_data(tio_usb_context_t *ctx, const uint8_t *data, uint32_t length)
+{
+    tio_usb_bulk_t *b = &tioUsbBulk;
+    if (length < TIO_USB_BULK_DATA_HDR_LEN)
+    {
+        return;
+    }
+    uint8_t id = data[1];
+    uint32_t offset = tio_usb_bulk_u32(data + 2);
+    uint32_t dlen = length - TIO_USB_BULK_DATA_HDR_LEN;
+    data += TIO_USB_BULK_DATA_HDR_LEN;
+    if (!b->active || id != b->state.id)
+    {
+        b->state.rejected++;
+        return;
+    }
+    // Go-back-N: anything but the next expected bytes is dropped, and the
+    // host is told once where to rewind to
+    if (offset != b->state.received || dlen == 0 || dlen > b->length - offset)
+    {
+        b->state.rejected++;
+        if (!b->nakSent)
+        {
+            b->nakSent = true;
+            tio_usb_bulk_ack();
+        }
+        return;
+    }
+    if (ctx->bulk.buffer != NULL)
+    {
+        memcpy(ctx->bulk.buffer + offset, data, dlen);
+    }
+    else if (ctx->bulk.sink_cb(b->state.id, offset, data, dlen))
+    {
+        tio_usb_bulk_finish(ctx, TIO_USB_BULK_ABORTED);
+        tio_usb_bulk_ack();
+        return;
+    }
+    b->crc = tio_crc32_update(b->crc, data, dlen);
+    b->state.received += dlen;
+    b->nakSent = false;
+    if (b->state.received == b->length)
+    {
+        tio_usb_bulk_finish(ctx, b->crc == b->objCrc ? TIO_USB_BULK_OK : TIO_USB_BULK_CRC_ERROR);
+        tio_usb_bulk_ack();
+    }
+    else if (++b->unacked >= (b->window + 1U) / 2)
+    {
+        tio_usb_bulk_ack();
+    }
+}
+
+void
+tio_usb_bulk_frame(tio_usb_context_t *ctx, const uint8_t *data, uint32_t length)
+{
+    if (length < 2)
+    {
+        return;
+    }
+    switch (data[0])
+    {
+    case TIO_USB_BULK_OP_OPEN:
+        tio_usb_bulk_open(ctx, data, length);
+        break;
+    case TIO_USB_BULK_OP_DATA:
+        tio_usb_bulk_data(ctx, data, length);
+        break;
+    case TIO_USB_BULK_OP_ABORT:
+        if (tioUsbBulk.active && data[1] == tioUsbBulk.state.id)
+        {
+            tio_usb_bulk_finish(ctx, TIO_USB_BULK_ABORTED);
+            tio_usb_bulk_ack();
+        }
+        break;
+    default:
+        // ACKs only go device -> host
+        break;
+    }
+}
+
+void
+tio_usb_bulk_reset(void)
+{
+    memset(&tioUsbBulk, 0, sizeof(tioUsbBulk));
+}
+
+/**
+ * @brief Get progress of the current (or last) bulk object
+ *
+ * @param state Bulk state
+ */
+void
+tio_usb_get_bulk(tio_usb_bulk_state_t *state)
+{
+    *state = tioUsbBulk.state;
+}
@@ -0,0 +1,178 @@
+/**
+ * @file tio_usb_frag.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio USB fragmentation and reassembly of large slot messages
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <stdatomic.h>
+#include "tio_crc.h"
+#include "tio_usb_priv.h"
+
+#define TIO_USB_FRAG_MAX_COUNT ((TIO_USB_REASM_MAX_LEN + TIO_USB_FRAG_DATA_LEN - 1) / TIO_USB_FRAG_DATA_LEN)
+
+#if TIO_USB_FRAG_MAX_COUNT > 32
+#error "TIO_USB_REASM_MAX_LEN exceeds 32 fragments"
+#endif
+
+typedef struct {
+    bool active;
+    uint8_t slot;
+    uint8_t slotType;
+    uint8_t msgId;
+    uint8_t count;
+    uint32_t received; // Bitmap of fragment indices
+    uint32_t length;   // Known once the last fragment arrived
+    uint32_t startTick;
+    uint32_t age;
+    uint8_t buffer[TIO_USB_REASM_MAX_LEN];
+} tio_usb_reasm_t;
+
+static tio_usb_reasm_t tioUsbReasm[TIO_USB_REASM_CTXS];
+static uint32_t tioUsbReasmAge = 0;
+static atomic_uint tioUsbTxMsgId = 0;
+
+/**
+ * @brief Find reassembly context for a message, claiming (or evicting) one if new
+ */
+static tio_usb_reasm_t *
+tio_usb_reasm_get(uint8_t slot, uint8_t slotType, uint8_t msgId, uint8_t count)
+{
+    tio_usb_reasm_t *victim = &tioUsbReasm[0];
+    for (uint32_t i = 0; i < TIO_USB_REASM_CTXS; i++)
+    {
+        tio_usb_reasm_t *r = &tioUsbReasm[i];
+        if (r->active && r->slot == slot && r->slotType == slotType && r->msgId == msgId)
+        {
+            return r->count == count ? r : NULL;
+        }
+        // Prefer a free context, else the least recently used one
+        if (victim->active && (!r->active || r->age < victim->age))
+        {
+            victim = r;
+        }
+    }
+    victim->active = true;
+    victim->slot = slot;
+    victim->slotType = slotType;
+    victim->msgId = msgId;
+    victim->count = count;
+    victim->received = 0;
+    victim->length = 0;
+    victim->startTick = (gTioUsbCtx && gTioUsbCtx->tick_us_cb) ? gTioUsbCtx->tick_us_cb() : 0;
+    return victim;
+}
+
+void
+tio_usb_reasm_frame(tio_usb_context_t *ctx, uint8_t slot, uint8_t slotType, const uint8_t *data, uint32_t length)
+{
+    if (length < TIO_USB_FRAG_HDR_LEN)
+    {
+        return;
+    }
+    uint8_t msgId = data[0];
+    uint8_t index = data[1];
+    uint8_t count = data[2];
+    uint32_t fragLen = length - TIO_USB_FRAG_HDR_LEN;
+    uint32_t offset = (uint32_t)index * TIO_USB_FRAG_DATA_LEN;
+    // Every fragment but the last is full
+    if (count == 0 || count > TIO_USB_FRAG_MAX_COUNT || index >= count ||
+        (index + 1 < count && fragLen != TIO_USB_FRAG_DATA_LEN) || offset + fragLen > TIO_USB_REASM_MAX_LEN)
+    {
+        return;
+    }
+    tio_usb_reasm_t *r = tio_usb_reasm_get(slot, slotType, msgId, count);
+    if (r == NULL)
+    {
+        return;
+    }
+    r->age = ++tioUsbReasmAge;
+    memcpy(r->buffer + offset, data + TIO_USB_FRAG_HDR_LEN, fragLen);
+    r->received |= 1UL << index;
+    if (index + 1 == count)
+    {
+        r->length = offset + fragLen;
+    }
+    if (r->received == (count == 32 ? 0xFFFFFFFFUL : (1UL << count) - 1))
+    {
+        r->active = false;
+        if (ctx->slot_update_cb != NULL)
+        {
+            ctx->slot_update_cb(slot, slotType, r->buffer, r->length);
+        }
+    }
+}
+
+void
+tio_usb_reasm_poll(tio_usb_context_t *ctx)
+{
+    uint32_t timeout = ctx->reasm_timeout_us ? ctx->reasm_timeout_us : TIO_USB_REASM_TIMEOUT_US;
+    if (ctx->tick_us_cb == NULL)
+    {
+        return;
+    }
+    uint32_t now = ctx->tick_us_cb();
+    for (uint32_t i = 0; i < TIO_USB_REASM_CTXS; i++)
+    {
+        if (tioUsbReasm[i].active && now - tioUsbReasm[i].startTick >= timeout)
+        {
+            tioUsbReasm[i].active = false;
+        }
+    }
+}
+
+void
+tio_usb_reasm_reset(void)
+{
+    for (uint32_t i = 0; i < TIO_USB_REASM_CTXS; i++)
+    {
+        tioUsbReasm[i].active = false;
+    }
+}
+
+uint32_t
+tio_usb_send_slot_message(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length)
+{
+    uint32_t count = (length + TIO_USB_FRAG_DATA_LEN - 1) / TIO_USB_FRAG_DATA_LEN;
+    if (count > 255)
+    {
+        ns_lp_printf("Data length exceeds limit\n");
+        return 1;
+    }
+    // A message missing fragments is dropped by the host anyway
+    if (tio_usb_tx_room(slot_type, count))
+    {
+        return 1;
+    }
+    uint8_t msgId = atomic_fetch_add_explicit(&tioUsbTxMsgId, 1, memory_order_relaxed);
+    uint8_t local[TIO_USB_PACKET_LEN];
+    for (uint32_t index = 0; index < count; index++)
+    {
+        uint32_t offset = index * TIO_USB_FRAG_DATA_LEN;
+        uint32_t fragLen = length - offset > TIO_USB_FRAG_DATA_LEN ? TIO_USB_FRAG_DATA_LEN : length - offset;
+        uint32_t dlen = fragLen + TIO_USB_FRAG_HDR_LEN;
+        uint8_t *frame = tio_usb_frame_reserve_local(slot, slot_type, local);
+        if (frame == NULL)
+        {
+            return 1;
+        }
+        uint8_t *hdr = frame - TIO_USB_DATA_IDX;
+        hdr[TIO_USB_TYPE_IDX] |= TIO_USB_FLAG_FRAGMENT;
+        hdr[TIO_USB_DLEN_IDX] = dlen & 0xFF;
+        hdr[TIO_USB_DLEN_IDX + 1] = (dlen >> 8) & 0xFF;
+        frame[0] = msgId;
+        frame[1] = index;
+        frame[2] = count;
+        uint16_t crc = tio_crc16(hdr + TIO_USB_DLEN_IDX, TIO_USB_DLEN_LEN + TIO_USB_FRAG_HDR_LEN);
+        crc = tio_crc16_copy(crc, frame + TIO_USB_FRAG_HDR_LEN, data + offset, fragLen);
+        if (tio_usb_frame_commit_crc(frame, dlen, crc))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
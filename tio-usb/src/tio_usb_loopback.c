@@ -0,0 +1,205 @@
+/**
+ * @file tio_usb_loopback.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio USB host loopback stand-ins for the USB stack
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef TIO_USB_HOST_LOOPBACK
+#error "tio_usb_loopback.c is host only (see host/Makefile)"
+#endif
+
+#include "tio_usb_priv.h"
+
+#define TIO_USB_LOOPBACK_PACKET_LEN 64
+
+const ns_core_api_t ns_usb_V1_0_0 = {.major = 1, .minor = 0, .revision = 0};
+char const *usb_string_desc_arr[USB_DESCRIPTOR_SERIAL + 1];
+
+// Bytes sent by the device, waiting to be looped back by the next poll
+static uint8_t loopPipe[TIO_USB_LOOPBACK_LEN];
+static uint32_t loopPipeLen = 0;
+
+static ns_usb_config_t *loopUsbConfig = NULL;
+static webusb_raw_cb loopRxCb = NULL;
+static void *loopRxArgs = NULL;
+static tio_usb_loopback_config_t loopConfig;
+static tio_usb_loopback_stats_t loopStats;
+
+/**
+ * @brief Get bytes the endpoint takes before the next poll
+ */
+static uint32_t
+tio_usb_loopback_window(void)
+{
+    uint32_t window = loopConfig.window ? loopConfig.window : TIO_USB_LOOPBACK_LEN;
+    return window > TIO_USB_LOOPBACK_LEN ? TIO_USB_LOOPBACK_LEN : window;
+}
+
+/**
+ * @brief Hand bytes to the device's receive callback one bulk packet at a time
+ */
+static void
+tio_usb_loopback_deliver(const uint8_t *buffer, uint32_t length)
+{
+    uint32_t packetLen = loopConfig.packet_len ? loopConfig.packet_len : TIO_USB_LOOPBACK_PACKET_LEN;
+    loopStats.rx_bytes += length;
+    while (length && loopRxCb)
+    {
+        uint32_t chunk = length < packetLen ? length : packetLen;
+        loopRxCb(buffer, chunk, loopRxArgs);
+        buffer += chunk;
+        length -= chunk;
+    }
+}
+
+uint32_t
+ns_usb_init(ns_usb_config_t *cfg, usb_handle_t *handle)
+{
+    loopUsbConfig = cfg;
+    loopPipeLen = 0;
+    memset(&loopStats, 0, sizeof(loopStats));
+    *handle = (usb_handle_t)cfg;
+    return 0;
+}
+
+void
+webusb_register_raw_cb(webusb_raw_cb cb, void *args)
+{
+    loopRxCb = cb;
+    loopRxArgs = args;
+}
+
+bool
+tud_vendor_mounted(void)
+{
+    return !loopConfig.unmounted;
+}
+
+uint32_t
+tud_vendor_write_available(void)
+{
+    uint32_t window = tio_usb_loopback_window();
+    return loopPipeLen < window ? window - loopPipeLen : 0;
+}
+
+void
+webusb_send_data(uint8_t *buf, uint32_t bufsize)
+{
+    if (bufsize > tud_vendor_write_available())
+    {
+        return;
+    }
+    loopStats.transfers++;
+    loopStats.tx_bytes += bufsize;
+    uint8_t *dst = loopPipe + loopPipeLen;
+    memcpy(dst, buf, bufsize);
+    // Transfers hold whole frames; the host end keeps control and bulk frames
+    uint32_t pos = 0;
+    while (pos < bufsize)
+    {
+        uint32_t frameLen = bufsize - pos >= TIO_USB_HDR_LEN ? tio_usb_frame_len(dst + pos) : 0;
+        if (frameLen == 0 || pos + frameLen > bufsize)
+        {
+            pos = bufsize;
+        }
+        else if ((dst[pos + TIO_USB_TYPE_IDX] & TIO_USB_TYPE_MASK) >= TIO_USB_TYPE_CTRL)
+        {
+            loopStats.ctrl_frames++;
+            if (loopConfig.host_cb)
+            {
+                loopConfig.host_cb(dst + pos, frameLen);
+            }
+            memmove(dst + pos, dst + pos + frameLen, bufsize - pos - frameLen);
+            bufsize -= frameLen;
+        }
+        else
+        {
+            pos += frameLen;
+        }
+    }
+    if (loopConfig.tap)
+    {
+        uint32_t tapped = loopConfig.tap(dst, bufsize);
+        bufsize = tapped < bufsize ? tapped : bufsize;
+    }
+    loopPipeLen += bufsize;
+}
+
+uint32_t
+am_hal_mcuctrl_info_get(uint32_t infoType, void *info)
+{
+    (void)infoType;
+    am_hal_mcuctrl_device_t *device = (am_hal_mcuctrl_device_t *)info;
+    device->ui32ChipID0 = 0x00100100;
+    device->ui32ChipID1 = 0x70017001;
+    return 0;
+}
+
+/**
+ * @brief Configure the loopback pipe (takes effect on the next transfer)
+ *
+ * @param cfg Loopback config
+ */
+void
+tio_usb_loopback_config(const tio_usb_loopback_config_t *cfg)
+{
+    loopConfig = *cfg;
+}
+
+/**
+ * @brief Receive bytes as if sent by the host (e.g. a HELLO frame)
+ *
+ * @param buffer Bytes
+ * @param length Byte count
+ * @return uint32_t
+ */
+uint32_t
+tio_usb_loopback_inject(const uint8_t *buffer, uint32_t length)
+{
+    if (loopRxCb == NULL)
+    {
+        return 1;
+    }
+    tio_usb_loopback_deliver(buffer, length);
+    return 0;
+}
+
+/**
+ * @brief Loop sent bytes back into the receive path and complete the transfers
+ *
+ * Transfers the device sends while receiving (e.g. from its callbacks) wait
+ * for the next poll.
+ *
+ * @return uint32_t Bytes looped back
+ */
+uint32_t
+tio_usb_loopback_poll(void)
+{
+    static uint8_t rxBuf[TIO_USB_LOOPBACK_LEN];
+    uint32_t length = loopPipeLen;
+    memcpy(rxBuf, loopPipe, length);
+    loopPipeLen = 0;
+    tio_usb_loopback_deliver(rxBuf, length);
+    if (loopUsbConfig && loopUsbConfig->tx_cb)
+    {
+        ns_usb_transaction_t transaction = {.handle = loopUsbConfig, .buffer = rxBuf, .length = length};
+        loopUsbConfig->tx_cb(&transaction);
+    }
+    return length;
+}
+
+/**
+ * @brief Get loopback pipe counters
+ *
+ * @param stats Counters
+ */
+void
+tio_usb_loopback_get_stats(tio_usb_loopback_stats_t *stats)
+{
+    *stats = loopStats;
+}
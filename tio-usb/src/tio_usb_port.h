@@ -0,0 +1,128 @@
+/**
+ * @file tio_usb_port.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio USB platform dependencies
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __TIO_USB_PORT_H
+#define __TIO_USB_PORT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef TIO_USB_HOST_LOOPBACK
+
+// tio-core is built w/ the loopback and needs its own host stand-ins
+#ifndef TIO_HOST_BUILD
+#error "TIO_USB_HOST_LOOPBACK needs TIO_HOST_BUILD"
+#endif
+
+// Host build: the neuralSPOT USB stack, HAL and TinyUSB vendor class are
+// replaced by the stand-ins below (tio_usb_loopback.c), which loop every
+// transfer the device sends back into its receive callback.
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define ns_lp_printf printf
+
+// Host side is single threaded
+#define AM_CRITICAL_BEGIN
+#define AM_CRITICAL_END
+
+typedef void *usb_handle_t;
+
+typedef struct {
+    usb_handle_t handle;
+    uint8_t *buffer;
+    uint32_t length;
+    uint8_t status;
+    void *param;
+} ns_usb_transaction_t;
+
+typedef void (*ns_usb_rx_cb)(ns_usb_transaction_t *);
+typedef void (*ns_usb_tx_cb)(ns_usb_transaction_t *);
+typedef void (*ns_usb_service_cb)(uint8_t);
+
+typedef struct {
+    uint8_t major;
+    uint8_t minor;
+    uint8_t revision;
+} ns_core_api_t;
+
+extern const ns_core_api_t ns_usb_V1_0_0;
+
+typedef enum {
+    NS_USB_CDC_DEVICE = 0,
+    NS_USB_HID_DEVICE,
+    NS_USB_VENDOR_DEVICE,
+    NS_USB_MSC_DEVICE,
+} ns_usb_device_type_e;
+
+typedef struct {
+    const ns_core_api_t *api;
+    ns_usb_device_type_e deviceType;
+    void *rx_buffer;
+    uint16_t rx_bufferLength;
+    void *tx_buffer;
+    uint16_t tx_bufferLength;
+    ns_usb_rx_cb rx_cb;
+    ns_usb_tx_cb tx_cb;
+    ns_usb_service_cb service_cb;
+} ns_usb_config_t;
+
+uint32_t
+ns_usb_init(ns_usb_config_t *cfg, usb_handle_t *handle);
+
+typedef void (*webusb_raw_cb)(const uint8_t *buffer, uint32_t length, void *args);
+
+void
+webusb_register_raw_cb(webusb_raw_cb cb, void *args);
+void
+webusb_send_data(uint8_t *buf, uint32_t bufsize);
+bool
+tud_vendor_mounted(void);
+uint32_t
+tud_vendor_write_available(void);
+
+typedef struct {
+    uint32_t ui32ChipID0;
+    uint32_t ui32ChipID1;
+} am_hal_mcuctrl_device_t;
+
+#define AM_HAL_MCUCTRL_INFO_DEVICEID 0
+
+uint32_t
+am_hal_mcuctrl_info_get(uint32_t infoType, void *info);
+
+enum {
+    USB_DESCRIPTOR_LANGUAGE = 0,
+    USB_DESCRIPTOR_MANUFACTURER,
+    USB_DESCRIPTOR_PRODUCT,
+    USB_DESCRIPTOR_SERIAL,
+};
+
+extern char const *usb_string_desc_arr[];
+
+#else
+
+#include "ns_ambiqsuite_harness.h"
+#include "arm_math.h"
+
+#include "ns_usb.h"
+#include "vendor_device.h"
+#include "usb_descriptors.h"
+
+#endif // TIO_USB_HOST_LOOPBACK
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __TIO_USB_PORT_H
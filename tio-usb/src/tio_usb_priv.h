@@ -0,0 +1,295 @@
+/**
+ * @file tio_usb_priv.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio USB internals shared between RX and TX paths
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __TIO_USB_PRIV_H
+#define __TIO_USB_PRIV_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tio_usb.h"
+#include "tio_usb_port.h"
+
+#define TIO_USB_START_IDX 0
+#define TIO_USB_START_VAL 0x55
+#define TIO_USB_SLOT_IDX 1
+#define TIO_USB_SLOT_MASK 0x0F
+#define TIO_USB_RATE_SHIFT 4
+#define TIO_USB_TYPE_IDX 2
+#define TIO_USB_TYPE_MASK 0x07
+#define TIO_USB_TYPE_CTRL 3
+#define TIO_USB_TYPE_BULK 4
+#define TIO_USB_DLEN_IDX 3
+#define TIO_USB_DLEN_LEN 2
+#define TIO_USB_DATA_IDX 5
+#define TIO_USB_DATA_LEN 248
+#define TIO_USB_CRC_IDX 253
+#define TIO_USB_CRC_LEN 2
+#define TIO_USB_STOP_IDX 255
+#define TIO_USB_STOP_VAL 0xAA
+#define TIO_USB_HDR_LEN 5
+#define TIO_USB_TRAILER_LEN 3
+#define TIO_USB_SEQ_LEN 1
+#define TIO_USB_TS_LEN 4
+#define TIO_USB_UIO_BUF_LEN (8)
+#define TIO_USB_FRAG_HDR_LEN 3
+#define TIO_USB_FRAG_DATA_LEN (TIO_USB_DATA_LEN - TIO_USB_FRAG_HDR_LEN)
+
+#define TIO_USB_TX_LANE_HI 0
+#define TIO_USB_TX_LANE_LO 1
+
+extern tio_usb_context_t *gTioUsbCtx;
+extern volatile uint16_t tioUsbCaps;
+extern tio_usb_perf_t tioUsbPerf;
+
+/**
+ * @brief Check if frame header implies a sequence byte after DATA
+ *
+ * @param slotType Slot type byte (incl. flags)
+ * @return bool
+ */
+static inline bool
+tio_usb_frame_has_seq(uint8_t slotType)
+{
+    return (slotType & (TIO_USB_FLAG_COMPACT | TIO_USB_FLAG_SEQ)) == (TIO_USB_FLAG_COMPACT | TIO_USB_FLAG_SEQ);
+}
+
+/**
+ * @brief Check if frame header implies a timestamp after DATA
+ *
+ * @param slotType Slot type byte (incl. flags)
+ * @return bool
+ */
+static inline bool
+tio_usb_frame_has_ts(uint8_t slotType)
+{
+    return (slotType & (TIO_USB_FLAG_COMPACT | TIO_USB_FLAG_TS)) == (TIO_USB_FLAG_COMPACT | TIO_USB_FLAG_TS);
+}
+
+/**
+ * @brief Get bytes between DATA and CRC (timestamp, then sequence number)
+ *
+ * @param slotType Slot type byte (incl. flags)
+ * @return uint32_t
+ */
+static inline uint32_t
+tio_usb_frame_ext_len(uint8_t slotType)
+{
+    return (tio_usb_frame_has_ts(slotType) ? TIO_USB_TS_LEN : 0) + (tio_usb_frame_has_seq(slotType) ? TIO_USB_SEQ_LEN : 0);
+}
+
+/**
+ * @brief Get frame length implied by frame header
+ *
+ * @param slotType Slot type byte (incl. flags)
+ * @param dlen Data length
+ * @return uint32_t
+ */
+static inline uint32_t
+tio_usb_frame_len_from_hdr(uint8_t slotType, uint32_t dlen)
+{
+    if (slotType & TIO_USB_FLAG_COMPACT)
+    {
+        return TIO_USB_HDR_LEN + dlen + tio_usb_frame_ext_len(slotType) + TIO_USB_TRAILER_LEN;
+    }
+    return TIO_USB_PACKET_LEN;
+}
+
+/**
+ * @brief Get STYPE flags for outgoing frames from negotiated capabilities
+ *
+ * @return uint8_t
+ */
+static inline uint8_t
+tio_usb_tx_flags(void)
+{
+    uint16_t caps = tioUsbCaps;
+    if (!(caps & TIO_USB_CAP_COMPACT))
+    {
+        return 0;
+    }
+    uint8_t flags = TIO_USB_FLAG_COMPACT | ((caps & TIO_USB_CAP_SEQ) ? TIO_USB_FLAG_SEQ : 0);
+    // Tick source may have been cleared since HELLO
+    if ((caps & TIO_USB_CAP_TIMESTAMP) && gTioUsbCtx->tick_us_cb)
+    {
+        flags |= TIO_USB_FLAG_TS;
+    }
+    return flags;
+}
+
+/**
+ * @brief Reset TX queues and hook TX callbacks into USB config
+ *
+ * @param config USB config
+ */
+void
+tio_usb_tx_init(ns_usb_config_t *config);
+
+/**
+ * @brief Queue a control frame from any context (always high priority)
+ *
+ * @param frame USB frame
+ * @param frameLen Frame length
+ * @return uint32_t
+ */
+uint32_t
+tio_usb_tx_post_ctrl(const uint8_t *frame, uint32_t frameLen);
+
+/**
+ * @brief Drain TX queues and flush expired batches (left to the TX lock
+ * holder if another context has it)
+ *
+ * @return uint32_t Number of frames sent to USB
+ */
+uint32_t
+tio_usb_tx_service(void);
+
+/**
+ * @brief Check that a multi-frame send fits before its first frame goes out
+ *
+ * Best effort, senders racing for the same lane may still be refused part
+ * way. Refused frames count as dropped.
+ *
+ * @param slot_type Slot type of the frames
+ * @param frames Number of frames
+ * @return uint32_t 0 if they fit, 1 if refused
+ */
+uint32_t
+tio_usb_tx_room(uint8_t slot_type, uint32_t frames);
+
+/**
+ * @brief Get signal lane fill
+ *
+ * @return uint32_t Percent of TIO_USB_TXQ_LO_DEPTH
+ */
+uint32_t
+tio_usb_tx_backlog(void);
+
+/**
+ * @brief Reserve a frame, or build it in the caller's memory while another
+ * sender holds the reservation
+ *
+ * @param slot Slot number
+ * @param slot_type Slot type
+ * @param local TIO_USB_PACKET_LEN bytes for the frame if the reservation is
+ *              taken (NULL - return NULL instead)
+ * @return uint8_t* DATA region or NULL if dropped
+ */
+uint8_t *
+tio_usb_frame_reserve_local(uint8_t slot, uint8_t slot_type, uint8_t *local);
+
+/**
+ * @brief Write LENGTH and send a frame from tio_usb_frame_reserve_local()
+ *
+ * @param frame DATA region
+ * @param length Data length
+ * @return uint32_t 0 if sent or queued, 1 if dropped
+ */
+uint32_t
+tio_usb_frame_commit_len(uint8_t *frame, uint32_t length);
+
+/**
+ * @brief Finish a frame whose LENGTH field and CRC the caller already produced
+ *
+ * A frame other than the outstanding reservation was built in the caller's
+ * memory and is queued like tio_usb_send_slot_packet() would.
+ *
+ * @param data DATA region returned by tio_usb_frame_reserve_local()
+ * @param length Data length
+ * @param crc CRC16 over LENGTH and DATA
+ * @return uint32_t 0 if sent or queued, 1 if dropped
+ */
+uint32_t
+tio_usb_frame_commit_crc(uint8_t *data, uint32_t length, uint16_t crc);
+
+/**
+ * @brief Write timestamp, sequence number, CRC and STOP after DATA
+ *
+ * Header STYPE must be set; extensions that don't fit next to a long DATA
+ * field are dropped from it (sequence number first). Only slot data frames
+ * are numbered and stamped.
+ *
+ * @param frame Frame
+ * @param length Data length
+ * @param crc CRC16 over LENGTH and DATA
+ * @return uint32_t Frame length
+ */
+uint32_t
+tio_usb_frame_finish(uint8_t *frame, uint32_t length, uint16_t crc);
+
+/**
+ * @brief Take next TX sequence number of a slot
+ *
+ * @param slot Slot number
+ * @return uint8_t
+ */
+uint8_t
+tio_usb_next_seq(uint8_t slot);
+
+/**
+ * @brief Add a received fragment to its message, delivering the message once complete
+ *
+ * @param ctx Tileio USB context
+ * @param slot Slot number
+ * @param slotType Slot type (w/o flags)
+ * @param data Fragment DATA (incl. fragment header)
+ * @param length Data length
+ */
+void
+tio_usb_reasm_frame(tio_usb_context_t *ctx, uint8_t slot, uint8_t slotType, const uint8_t *data, uint32_t length);
+
+/**
+ * @brief Drop partial messages older than the reassembly timeout
+ *
+ * @param ctx Tileio USB context
+ */
+void
+tio_usb_reasm_poll(tio_usb_context_t *ctx);
+
+/**
+ * @brief Drop all partial messages
+ */
+void
+tio_usb_reasm_reset(void);
+
+/**
+ * @brief Handle a bulk downlink frame
+ *
+ * @param ctx Tileio USB context
+ * @param data Frame DATA
+ * @param length Data length
+ */
+void
+tio_usb_bulk_frame(tio_usb_context_t *ctx, const uint8_t *data, uint32_t length);
+
+/**
+ * @brief Drop the bulk object in progress w/o reporting it
+ */
+void
+tio_usb_bulk_reset(void);
+
+/**
+ * @brief Send slot data larger than one frame as a run of fragment frames
+ *
+ * @param slot Slot number
+ * @param slot_type Slot type
+ * @param data Slot data
+ * @param length Data length
+ * @return uint32_t
+ */
+uint32_t
+tio_usb_send_slot_message(uint8_t slot, uint8_t slot_type, const uint8_t *data, uint32_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __TIO_USB_PRIV_H
@@ -0,0 +1,1039 @@
+/**
+ * @file tio_usb_tx.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Tileio USB transmit queue and batching
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <stdatomic.h>
+#include "ringbuffer.h"
+#include "tio_crc.h"
+#include "tio_usb_priv.h"
+
+// Work asked of the TX lock holder by contexts that found it taken
+#define TIO_USB_TX_KICK_DRAIN 0x01
+#define TIO_USB_TX_KICK_FLUSH 0x02
+#define TIO_USB_TX_KICK_DETACH 0x04 // Drop frames packed for the previous host
+
+// tio_usb_frame_reserve() states
+#define TIO_USB_RESV_IDLE 0
+#define TIO_USB_RESV_WRITING 1 // Caller owns the frame
+#define TIO_USB_RESV_STAGED 2  // Committed to the stage, added by the TX lock holder
+
+// Frames are coalesced here and sent as one transfer
+static uint8_t tioTxStage[TIO_USB_TX_STAGE_LEN];
+static uint32_t tioTxStageLen = 0;
+static uint32_t tioTxStageFrames = 0;
+static uint32_t tioTxStageLaneFrames[TIO_USB_TX_LANES];
+static uint32_t tioTxStageTick = 0;
+static uint32_t tioTxWireFrames = 0;
+
+// Frames waiting for USB space. Each element holds one frame (fixed or compact).
+static uint8_t tioTxLaneHiData[(TIO_USB_TXQ_HI_DEPTH + 1) * TIO_USB_PACKET_LEN];
+static uint8_t tioTxLaneLoData[(TIO_USB_TXQ_LO_DEPTH + 1) * TIO_USB_PACKET_LEN];
+static rb_config_t tioTxLanes[TIO_USB_TX_LANES] = {
+    {
+        .buffer = (void *)tioTxLaneHiData,
+        .dlen = TIO_USB_PACKET_LEN,
+        .size = TIO_USB_TXQ_HI_DEPTH + 1,
+        .head = 0,
+        .tail = 0,
+    },
+    {
+        .buffer = (void *)tioTxLaneLoData,
+        .dlen = TIO_USB_PACKET_LEN,
+        .size = TIO_USB_TXQ_LO_DEPTH + 1,
+        .head = 0,
+        .tail = 0,
+    }};
+
+static tio_usb_tx_stats_t tioTxStats;
+static tio_usb_latency_t tioTxLatency[TIO_USB_SLOTS];
+
+// Outstanding tio_usb_frame_reserve() (one at a time). The stage can't move
+// while a frame is reserved in it, so staged and sent frames wait behind it.
+static atomic_uint tioTxResv = TIO_USB_RESV_IDLE;
+static atomic_bool tioTxResvInStage = false;
+static uint8_t *tioTxResvFrame = NULL;
+static uint8_t tioTxResvLane = 0;
+static uint32_t tioTxResvLen = 0;
+
+// Held while dequeuing or touching the stage. Nobody waits for it: a context
+// that finds it taken leaves its request in tioTxKick and the holder runs it
+// before letting go, so a preempted holder never stalls a higher priority
+// task or ISR on a single core.
+static atomic_flag tioTxLock = ATOMIC_FLAG_INIT;
+static atomic_uint tioTxKick = 0;
+
+static inline bool
+tio_usb_tx_trylock(void)
+{
+    return !atomic_flag_test_and_set(&tioTxLock);
+}
+
+/**
+ * @brief Check whether a reservation sits at the end of the stage
+ */
+static inline bool
+tio_usb_stage_busy(void)
+{
+    return atomic_load(&tioTxResvInStage);
+}
+
+/**
+ * @brief Check if USB is mounted and has space to send given bytes
+ * @param length Bytes to send
+ * @return uint32_t
+ */
+static uint32_t
+tio_usb_tx_space(uint32_t length)
+{
+    if (!tud_vendor_mounted()) {
+        // Host must renegotiate after reattaching, frames packed for this
+        // one are stale
+        tioUsbCaps = 0;
+        atomic_fetch_or(&tioTxKick, TIO_USB_TX_KICK_DETACH);
+        return 0;
+    }
+    if (tud_vendor_write_available() < length) {
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Add pack to hand-off time of each timestamped frame in a transfer
+ *
+ * @param buffer Whole frames
+ * @param length Data length
+ */
+static void
+tio_usb_latency_record(const uint8_t *buffer, uint32_t length)
+{
+    if (!(tio_usb_tx_flags() & TIO_USB_FLAG_TS))
+    {
+        return;
+    }
+    uint32_t now = gTioUsbCtx->tick_us_cb();
+    uint32_t pos = 0;
+    while (length - pos >= TIO_USB_HDR_LEN)
+    {
+        const uint8_t *frame = buffer + pos;
+        uint32_t frameLen = tio_usb_frame_len(frame);
+        if (frameLen == 0 || frameLen > length - pos)
+        {
+            return;
+        }
+        pos += frameLen;
+        uint8_t slot = frame[TIO_USB_SLOT_IDX] & TIO_USB_SLOT_MASK;
+        if (!tio_usb_frame_has_ts(frame[TIO_USB_TYPE_IDX]) || slot >= TIO_USB_SLOTS)
+        {
+            continue;
+        }
+        const uint8_t *ts = frame + TIO_USB_DATA_IDX + (frame[TIO_USB_DLEN_IDX] | (frame[TIO_USB_DLEN_IDX + 1] << 8));
+        uint32_t latency = now - (ts[0] | (ts[1] << 8) | (ts[2] << 16) | ((uint32_t)ts[3] << 24));
+        // Bucket b > 0 holds [2^(b-1), 2^b) us, the last one everything above
+        uint32_t bucket = 0;
+        while (bucket < TIO_USB_LAT_BUCKETS - 1 && (latency >> bucket))
+        {
+            bucket++;
+        }
+        tio_usb_latency_t *lat = &tioTxLatency[slot];
+        lat->buckets[bucket]++;
+        lat->max_us = latency > lat->max_us ? latency : lat->max_us;
+    }
+}
+
+/**
+ * @brief Write bytes straight to the USB endpoint
+ *
+ * @param buffer Data
+ * @param length Data length
+ * @return uint32_t
+ */
+static uint32_t
+tio_usb_write(const uint8_t *buffer, uint32_t length)
+{
+    if (!tio_usb_tx_space(length)) {
+        return 1;
+    }
+    tio_usb_latency_record(buffer, length);
+    webusb_send_data((uint8_t *)buffer, length);
+    return 0;
+}
+
+/**
+ * @brief Get staging limit for current batch config
+ *
+ * @return uint32_t
+ */
+static uint32_t
+tio_usb_batch_max_bytes(void)
+{
+    uint32_t maxBytes = gTioUsbCtx ? gTioUsbCtx->batch.max_bytes : 0;
+    if (maxBytes < TIO_USB_PACKET_LEN)
+    {
+        return TIO_USB_PACKET_LEN;
+    }
+    return maxBytes > TIO_USB_TX_STAGE_LEN ? TIO_USB_TX_STAGE_LEN : maxBytes;
+}
+
+/**
+ * @brief Send all staged frames as one transfer
+ *
+ * @return uint32_t Number of frames sent
+ */
+static uint32_t
+tio_usb_stage_flush(void)
+{
+    uint32_t frames = tioTxStageFrames;
+    uint32_t bytes = tioTxStageLen;
+    if (bytes == 0 || tio_usb_stage_busy() || tio_usb_write(tioTxStage, bytes))
+    {
+        return 0;
+    }
+    for (uint8_t lane = 0; lane < TIO_USB_TX_LANES; lane++)
+    {
+        tioTxStats.lanes[lane].sent += tioTxStageLaneFrames[lane];
+        tioTxStageLaneFrames[lane] = 0;
+    }
+    tioTxStageLen = 0;
+    tioTxStageFrames = 0;
+    tioTxWireFrames += frames;
+    if (gTioUsbCtx && gTioUsbCtx->tx_flush_cb)
+    {
+        gTioUsbCtx->tx_flush_cb(frames, bytes);
+    }
+    return frames;
+}
+
+/**
+ * @brief Flush staged frames whose latency deadline has passed
+ *
+ * @return uint32_t Number of frames sent
+ */
+static uint32_t
+tio_usb_stage_poll(void)
+{
+    if (tioTxStageLen == 0 || gTioUsbCtx == NULL)
+    {
+        return 0;
+    }
+    // W/o a tick source every poll counts as a deadline
+    if (gTioUsbCtx->tick_us_cb &&
+        gTioUsbCtx->tick_us_cb() - tioTxStageTick < gTioUsbCtx->batch.max_latency_us)
+    {
+        return 0;
+    }
+    return tio_usb_stage_flush();
+}
+
+/**
+ * @brief Account for a frame written at the end of the stage
+ *
+ * @param lane Lane the frame counts against
+ * @param frameLen Frame length
+ */
+static void
+tio_usb_stage_commit(uint8_t lane, uint32_t frameLen)
+{
+    uint32_t maxLatency = gTioUsbCtx ? gTioUsbCtx->batch.max_latency_us : 0;
+    uint32_t maxBytes = tio_usb_batch_max_bytes();
+    if (tioTxStageLen == 0 && gTioUsbCtx && gTioUsbCtx->tick_us_cb)
+    {
+        tioTxStageTick = gTioUsbCtx->tick_us_cb();
+    }
+    tioTxStageLen += frameLen;
+    tioTxStageFrames++;
+    tioTxStageLaneFrames[lane]++;
+    if (tioTxStageLen > tioTxStats.stage_max)
+    {
+        tioTxStats.stage_max = tioTxStageLen;
+    }
+    // Flush once no other frame could fit or deadline passed
+    if (maxLatency == 0 || tioTxStageLen + TIO_USB_HDR_LEN + TIO_USB_TRAILER_LEN > maxBytes)
+    {
+        tio_usb_stage_flush();
+    }
+    else if (gTioUsbCtx->tick_us_cb)
+    {
+        tio_usb_stage_poll();
+    }
+}
+
+/**
+ * @brief Hand a frame to the stage (or endpoint when not batching)
+ *
+ * Frames are counted as sent once they're written to USB.
+ *
+ * @param lane Lane the frame counts against
+ * @param frame USB frame
+ * @param frameLen Frame length
+ * @return uint32_t 0 if accepted, 1 if USB has no room
+ */
+static uint32_t
+tio_usb_tx_emit(uint8_t lane, const uint8_t *frame, uint32_t frameLen)
+{
+    uint32_t maxLatency = gTioUsbCtx ? gTioUsbCtx->batch.max_latency_us : 0;
+    if (tio_usb_stage_busy())
+    {
+        return 1;
+    }
+    // Nothing to coalesce w/
+    if (tioTxStageLen == 0 && maxLatency == 0)
+    {
+        if (tio_usb_write(frame, frameLen))
+        {
+            return 1;
+        }
+        tioTxStats.lanes[lane].sent++;
+        tioTxWireFrames++;
+        return 0;
+    }
+    uint32_t maxBytes = tio_usb_batch_max_bytes();
+    if (tioTxStageLen + frameLen > maxBytes)
+    {
+        tio_usb_stage_flush();
+        if (tioTxStageLen + frameLen > maxBytes)
+        {
+            return 1;
+        }
+    }
+    memcpy(tioTxStage + tioTxStageLen, frame, frameLen);
+    tio_usb_stage_commit(lane, frameLen);
+    return 0;
+}
+
+/**
+ * @brief Get the next free frame slot of a lane (critical section held)
+ *
+ * Evicting the oldest frame races the drain, so only the TX lock holder may.
+ *
+ * @param lane Lane index
+ * @param dropOldest Evict oldest frame if lane is full
+ * @return uint8_t* Frame slot or NULL if lane is full
+ */
+static uint8_t *
+tio_usb_tx_lane_reserve(uint8_t lane, bool dropOldest)
+{
+    rb_config_t *q = &tioTxLanes[lane];
+    size_t n = 1;
+    if (ringbuffer_space(q) == 0 && dropOldest)
+    {
+        ringbuffer_seek(q, 1);
+        tioTxStats.lanes[lane].dropped++;
+    }
+    return ringbuffer_reserve(q, &n);
+}
+
+/**
+ * @brief Publish the frame written into a lane's reserved slot (critical section held)
+ *
+ * @param lane Lane index
+ */
+static void
+tio_usb_tx_lane_commit(uint8_t lane)
+{
+    ringbuffer_commit(&tioTxLanes[lane], 1);
+    tioTxStats.lanes[lane].queued++;
+    uint32_t depth = ringbuffer_len(&tioTxLanes[lane]);
+    if (depth > tioTxStats.lanes[lane].max_depth)
+    {
+        tioTxStats.lanes[lane].max_depth = depth;
+    }
+}
+
+/**
+ * @brief Count a frame dropped from a lane
+ */
+static void
+tio_usb_tx_count_drop(uint8_t lane)
+{
+    AM_CRITICAL_BEGIN
+    tioTxStats.lanes[lane].dropped++;
+    AM_CRITICAL_END
+}
+
+/**
+ * @brief Add frame to a lane from any context
+ *
+ * @param lane Lane index
+ * @param frame USB frame
+ * @param frameLen Frame length
+ * @param dropOldest Evict oldest frame if lane is full (TX lock held)
+ * @return uint32_t 0 if queued, 1 if lane is full
+ */
+static uint32_t
+tio_usb_tx_enqueue(uint8_t lane, const uint8_t *frame, uint32_t frameLen, bool dropOldest)
+{
+    uint32_t rst = 1;
+    // Producers may be any task or the RX callback, so the copy is done w/ the
+    // slot held
+    AM_CRITICAL_BEGIN
+    // Head slot is taken while a reservation sits in this lane
+    if (!(tioTxResvFrame && !tio_usb_stage_busy() && tioTxResvLane == lane))
+    {
+        uint8_t *slot = tio_usb_tx_lane_reserve(lane, dropOldest);
+        if (slot != NULL)
+        {
+            memcpy(slot, frame, frameLen);
+            tio_usb_tx_lane_commit(lane);
+            rst = 0;
+        }
+    }
+    AM_CRITICAL_END
+    return rst;
+}
+
+/**
+ * @brief Hold a lane's next free slot for a reservation
+ *
+ * @param lane Lane index
+ * @param dropOldest Evict oldest frame if lane is full (TX lock held)
+ * @return uint8_t* Frame slot or NULL if lane is full
+ */
+static uint8_t *
+tio_usb_tx_lane_hold(uint8_t lane, bool dropOldest)
+{
+    uint8_t *slot;
+    AM_CRITICAL_BEGIN
+    slot = tio_usb_tx_lane_reserve(lane, dropOldest);
+    if (slot != NULL)
+    {
+        tioTxResvLane = lane;
+        tioTxResvFrame = slot;
+    }
+    AM_CRITICAL_END
+    return slot;
+}
+
+/**
+ * @brief Move queued frames to USB, high priority lane first (lock held)
+ *
+ * @return uint32_t Number of frames dequeued
+ */
+static uint32_t
+tio_usb_tx_drain(void)
+{
+    uint32_t sent = 0;
+    // A frame committed to the stage goes ahead of what queued behind it
+    if (atomic_load(&tioTxResv) == TIO_USB_RESV_STAGED)
+    {
+        tioTxResvFrame = NULL;
+        atomic_store(&tioTxResvInStage, false);
+        atomic_store(&tioTxResv, TIO_USB_RESV_IDLE);
+        tio_usb_stage_commit(tioTxResvLane, tioTxResvLen);
+    }
+    for (uint8_t lane = 0; lane < TIO_USB_TX_LANES; lane++)
+    {
+        size_t n;
+        const uint8_t *frame;
+        while ((frame = ringbuffer_front(&tioTxLanes[lane], &n)) != NULL)
+        {
+            if (tio_usb_tx_emit(lane, frame, tio_usb_frame_len(frame)))
+            {
+                tio_usb_stage_poll();
+                return sent;
+            }
+            AM_CRITICAL_BEGIN
+            ringbuffer_seek(&tioTxLanes[lane], 1);
+            AM_CRITICAL_END
+            sent++;
+        }
+    }
+    tio_usb_stage_poll();
+    return sent;
+}
+
+/**
+ * @brief Drop staged and queued frames after the host went away (lock held)
+ */
+static void
+tio_usb_tx_discard(void)
+{
+    // A frame reserved in the stage keeps it, its flush fails and retries
+    if (!tio_usb_stage_busy())
+    {
+        for (uint8_t lane = 0; lane < TIO_USB_TX_LANES; lane++)
+        {
+            tioTxStats.lanes[lane].dropped += tioTxStageLaneFrames[lane];
+            tioTxStageLaneFrames[lane] = 0;
+        }
+        tioTxStageLen = 0;
+        tioTxStageFrames = 0;
+    }
+    AM_CRITICAL_BEGIN
+    for (uint8_t lane = 0; lane < TIO_USB_TX_LANES; lane++)
+    {
+        uint32_t depth = ringbuffer_len(&tioTxLanes[lane]);
+        ringbuffer_seek(&tioTxLanes[lane], depth);
+        tioTxStats.lanes[lane].dropped += depth;
+    }
+    AM_CRITICAL_END
+}
+
+/**
+ * @brief Carry out requests left for the TX lock holder (lock held)
+ *
+ * @param req TIO_USB_TX_KICK_* flags
+ * @return uint32_t Number of frames sent to USB
+ */
+static uint32_t
+tio_usb_tx_run(uint32_t req)
+{
+    uint32_t frames = tioTxWireFrames;
+    if (req & TIO_USB_TX_KICK_DETACH)
+    {
+        tio_usb_tx_discard();
+    }
+    tio_usb_tx_drain();
+    if (req & TIO_USB_TX_KICK_FLUSH)
+    {
+        tio_usb_stage_flush();
+    }
+    return tioTxWireFrames - frames;
+}
+
+/**
+ * @brief Release the TX lock, first running what others asked for meanwhile
+ */
+static void
+tio_usb_tx_unlock(void)
+{
+    atomic_flag_clear(&tioTxLock);
+    // A request left after this check finds the lock free and runs itself
+    while (atomic_load(&tioTxKick) && tio_usb_tx_trylock())
+    {
+        tio_usb_tx_run(atomic_exchange(&tioTxKick, 0));
+        atomic_flag_clear(&tioTxLock);
+    }
+}
+
+/**
+ * @brief Run a request now, or leave it to the context holding the TX lock
+ *
+ * @param req TIO_USB_TX_KICK_* flags
+ * @return uint32_t Number of frames sent to USB by this context
+ */
+static uint32_t
+tio_usb_tx_kick(uint32_t req)
+{
+    uint32_t frames = 0;
+    atomic_fetch_or(&tioTxKick, req);
+    if (tio_usb_tx_trylock())
+    {
+        frames = tio_usb_tx_run(atomic_exchange(&tioTxKick, 0));
+        tio_usb_tx_unlock();
+    }
+    return frames;
+}
+
+/**
+ * @brief Check whether lanes at or above given priority are empty
+ */
+static bool
+tio_usb_tx_lanes_empty(uint8_t lane)
+{
+    for (uint8_t i = 0; i <= lane; i++)
+    {
+        if (ringbuffer_len(&tioTxLanes[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Get lane full policy for slot type
+ */
+static tio_usb_tx_policy_t
+tio_usb_tx_get_policy(uint8_t slotType)
+{
+    tio_usb_tx_policy_t policy = {.policy = TIO_USB_DROP_NEWEST, .timeout_us = 0};
+    if (gTioUsbCtx && slotType < TIO_USB_TX_POLICIES)
+    {
+        policy = gTioUsbCtx->tx_policy[slotType];
+    }
+    return policy;
+}
+
+/**
+ * @brief Send frame or queue it according to its slot type's policy
+ *
+ * W/o the TX lock the frame is queued for its holder to send, and a full lane
+ * only evicts (TIO_USB_DROP_OLDEST) once the lock is had.
+ *
+ * @param frame USB frame
+ * @param frameLen Frame length
+ * @return uint32_t 0 if sent or queued, 1 if dropped
+ */
+static uint32_t
+tio_usb_tx_submit(const uint8_t *frame, uint32_t frameLen)
+{
+    uint8_t slotType = frame[TIO_USB_TYPE_IDX] & TIO_USB_TYPE_MASK;
+    uint8_t lane = slotType == 0 ? TIO_USB_TX_LANE_LO : TIO_USB_TX_LANE_HI;
+    tio_usb_tx_policy_t policy = tio_usb_tx_get_policy(slotType);
+    uint32_t rst = 0;
+    if (!tio_usb_tx_space(0))
+    {
+        tio_usb_tx_count_drop(lane);
+        tio_usb_tx_kick(TIO_USB_TX_KICK_DETACH);
+        return 1;
+    }
+    bool locked = tio_usb_tx_trylock();
+    if (locked)
+    {
+        tio_usb_tx_drain();
+        // Skip the queue when nothing of same or higher priority is waiting
+        if (tio_usb_tx_lanes_empty(lane) && tio_usb_tx_emit(lane, frame, frameLen) == 0)
+        {
+            tio_usb_tx_unlock();
+            return 0;
+        }
+    }
+    pfnTickUs tick = gTioUsbCtx ? gTioUsbCtx->tick_us_cb : NULL;
+    uint32_t start = tick ? tick() : 0;
+    while (tio_usb_tx_enqueue(lane, frame, frameLen, locked && policy.policy == TIO_USB_DROP_OLDEST))
+    {
+        // Blocking needs a tick source to bound the wait
+        if (policy.policy != TIO_USB_BLOCK || tick == NULL || tick() - start >= policy.timeout_us)
+        {
+            tio_usb_tx_count_drop(lane);
+            rst = 1;
+            break;
+        }
+        if (locked || (locked = tio_usb_tx_trylock()))
+        {
+            tio_usb_tx_drain();
+        }
+    }
+    if (locked)
+    {
+        tio_usb_tx_unlock();
+    }
+    else
+    {
+        tio_usb_tx_kick(TIO_USB_TX_KICK_DRAIN);
+    }
+    return rst;
+}
+
+/**
+ * @brief End the outstanding reservation w/o adding a frame
+ */
+static void
+tio_usb_frame_release(void)
+{
+    AM_CRITICAL_BEGIN
+    tioTxResvFrame = NULL;
+    AM_CRITICAL_END
+    atomic_store(&tioTxResvInStage, false);
+    atomic_store(&tioTxResv, TIO_USB_RESV_IDLE);
+    // Frames may have queued behind it
+    tio_usb_tx_kick(TIO_USB_TX_KICK_DRAIN);
+}
+
+/**
+ * @brief Write START, SLOT and STYPE of a frame about to be filled
+ *
+ * @return uint8_t* DATA region
+ */
+static uint8_t *
+tio_usb_frame_hdr(uint8_t *frame, uint8_t slot, uint8_t slot_type)
+{
+    frame[TIO_USB_START_IDX] = TIO_USB_START_VAL;
+    frame[TIO_USB_SLOT_IDX] = slot;
+    frame[TIO_USB_TYPE_IDX] = slot_type | tio_usb_tx_flags();
+    return frame + TIO_USB_DATA_IDX;
+}
+
+uint8_t *
+tio_usb_frame_reserve_local(uint8_t slot, uint8_t slot_type, uint8_t *local)
+{
+    uint8_t lane = slot_type == 0 ? TIO_USB_TX_LANE_LO : TIO_USB_TX_LANE_HI;
+    uint8_t *frame = NULL;
+    unsigned int idle = TIO_USB_RESV_IDLE;
+    if (!tio_usb_tx_space(0))
+    {
+        tio_usb_tx_count_drop(lane);
+        tio_usb_tx_kick(TIO_USB_TX_KICK_DETACH);
+        return NULL;
+    }
+    if (!atomic_compare_exchange_strong(&tioTxResv, &idle, TIO_USB_RESV_WRITING))
+    {
+        // Another sender holds the reservation, build the frame in place and
+        // queue it on commit like any other
+        return local ? tio_usb_frame_hdr(local, slot, slot_type) : NULL;
+    }
+    // Stage space is picked under the TX lock, w/o it the frame goes to a lane
+    bool locked = tio_usb_tx_trylock();
+    if (locked)
+    {
+        tio_usb_tx_drain();
+    }
+    if (locked && tio_usb_tx_lanes_empty(lane))
+    {
+        uint32_t maxBytes = tio_usb_batch_max_bytes();
+        if (tioTxStageLen + TIO_USB_PACKET_LEN > maxBytes)
+        {
+            tio_usb_stage_flush();
+        }
+        if (tioTxStageLen + TIO_USB_PACKET_LEN <= maxBytes)
+        {
+            // Marked first so enqueue never takes it for a lane's held slot
+            atomic_store(&tioTxResvInStage, true);
+            frame = tioTxStage + tioTxStageLen;
+            tioTxResvLane = lane;
+            tioTxResvFrame = frame;
+        }
+    }
+    if (frame == NULL)
+    {
+        tio_usb_tx_policy_t policy = tio_usb_tx_get_policy(slot_type);
+        pfnTickUs tick = gTioUsbCtx ? gTioUsbCtx->tick_us_cb : NULL;
+        uint32_t start = tick ? tick() : 0;
+        bool evict = policy.policy == TIO_USB_DROP_OLDEST;
+        while ((frame = tio_usb_tx_lane_hold(lane, locked && evict)) == NULL)
+        {
+            if (policy.policy != TIO_USB_BLOCK || tick == NULL || tick() - start >= policy.timeout_us)
+            {
+                tio_usb_tx_count_drop(lane);
+                if (locked)
+                {
+                    tio_usb_tx_unlock();
+                }
+                tio_usb_frame_release();
+                return NULL;
+            }
+            if (locked || (locked = tio_usb_tx_trylock()))
+            {
+                tio_usb_tx_drain();
+            }
+        }
+    }
+    // Nobody else touches the reserved frame, so TX is free meanwhile
+    if (locked)
+    {
+        tio_usb_tx_unlock();
+    }
+    return tio_usb_frame_hdr(frame, slot, slot_type);
+}
+
+/**
+ * @brief Reserve a frame in the TX stage (or a queue lane when USB is busy)
+ *
+ * Write the payload into the returned DATA region and hand it back w/
+ * tio_usb_frame_commit(). One reservation may be outstanding at a time and
+ * frames sent meanwhile queue behind it, so commit promptly.
+ *
+ * @param slot Slot number (0 - TIO_SLOTS-1)
+ * @param slot_type Slot type (0 - signal, 1 - metric, 2 - uio)
+ * @return uint8_t* DATA region (TIO_USB_DATA_LEN bytes), NULL if dropped or
+ *                  another reservation is outstanding (send w/
+ *                  tio_usb_send_slot_data() instead)
+ */
+uint8_t *
+tio_usb_frame_reserve(uint8_t slot, uint8_t slot_type)
+{
+    return tio_usb_frame_reserve_local(slot, slot_type, NULL);
+}
+
+uint32_t
+tio_usb_frame_finish(uint8_t *frame, uint32_t length, uint16_t crc)
+{
+    uint8_t slotType = frame[TIO_USB_TYPE_IDX];
+    // Control and bulk frames would take slot 0's sequence numbers and
+    // show up in its latency histogram
+    if ((slotType & TIO_USB_TYPE_MASK) >= TIO_USB_TYPE_CTRL)
+    {
+        slotType &= ~(TIO_USB_FLAG_SEQ | TIO_USB_FLAG_TS);
+    }
+    if (TIO_USB_HDR_LEN + length + tio_usb_frame_ext_len(slotType) + TIO_USB_TRAILER_LEN > TIO_USB_PACKET_LEN)
+    {
+        slotType &= ~TIO_USB_FLAG_SEQ;
+    }
+    if (TIO_USB_HDR_LEN + length + tio_usb_frame_ext_len(slotType) + TIO_USB_TRAILER_LEN > TIO_USB_PACKET_LEN)
+    {
+        slotType &= ~TIO_USB_FLAG_TS;
+    }
+    frame[TIO_USB_TYPE_IDX] = slotType;
+    uint8_t *ext = frame + TIO_USB_DATA_IDX + length;
+    // Timestamp and sequence number are taken when packed
+    if (tio_usb_frame_has_ts(slotType))
+    {
+        uint32_t now = gTioUsbCtx->tick_us_cb();
+        ext[0] = now & 0xFF;
+        ext[1] = (now >> 8) & 0xFF;
+        ext[2] = (now >> 16) & 0xFF;
+        ext[3] = (now >> 24) & 0xFF;
+        ext += TIO_USB_TS_LEN;
+    }
+    if (tio_usb_frame_has_seq(slotType))
+    {
+        ext[0] = tio_usb_next_seq(frame[TIO_USB_SLOT_IDX] & TIO_USB_SLOT_MASK);
+        ext += TIO_USB_SEQ_LEN;
+    }
+    uint32_t extLen = ext - (frame + TIO_USB_DATA_IDX + length);
+    crc = tio_crc16_update(crc, frame + TIO_USB_DATA_IDX + length, extLen);
+    uint32_t frameLen = tio_usb_frame_len_from_hdr(slotType, length);
+    frame[frameLen - TIO_USB_TRAILER_LEN] = crc & 0xFF;
+    frame[frameLen - TIO_USB_TRAILER_LEN + 1] = (crc >> 8) & 0xFF;
+    frame[frameLen - 1] = TIO_USB_STOP_VAL;
+    tioUsbPerf.pack_frames++;
+    return frameLen;
+}
+
+uint32_t
+tio_usb_frame_commit_crc(uint8_t *data, uint32_t length, uint16_t crc)
+{
+    uint8_t *frame = data - TIO_USB_DATA_IDX;
+    if (atomic_load(&tioTxResv) != TIO_USB_RESV_WRITING || frame != tioTxResvFrame)
+    {
+        // Frame in the caller's memory (tio_usb_frame_reserve_local())
+        return tio_usb_tx_submit(frame, tio_usb_frame_finish(frame, length, crc));
+    }
+    uint32_t frameLen = tio_usb_frame_finish(frame, length, crc);
+    if (tio_usb_stage_busy())
+    {
+        // Added to the stage by whoever holds TX next, which is usually us
+        tioTxResvLen = frameLen;
+        atomic_store(&tioTxResv, TIO_USB_RESV_STAGED);
+    }
+    else
+    {
+        AM_CRITICAL_BEGIN
+        tio_usb_tx_lane_commit(tioTxResvLane);
+        tioTxResvFrame = NULL;
+        AM_CRITICAL_END
+        atomic_store(&tioTxResv, TIO_USB_RESV_IDLE);
+    }
+    tio_usb_tx_kick(TIO_USB_TX_KICK_DRAIN);
+    return 0;
+}
+
+/**
+ * @brief Finish a reserved frame and send it
+ *
+ * @param frame DATA region returned by tio_usb_frame_reserve()
+ * @param length Bytes written (max 248)
+ * @return uint32_t
+ */
+uint32_t
+tio_usb_frame_commit(uint8_t *frame, uint32_t length)
+{
+    if (atomic_load(&tioTxResv) != TIO_USB_RESV_WRITING || frame != tioTxResvFrame + TIO_USB_DATA_IDX)
+    {
+        return 1;
+    }
+    return tio_usb_frame_commit_len(frame, length);
+}
+
+uint32_t
+tio_usb_frame_commit_len(uint8_t *frame, uint32_t length)
+{
+    if (length > TIO_USB_DATA_LEN)
+    {
+        ns_lp_printf("Data length exceeds limit\n");
+        tio_usb_frame_cancel(frame);
+        return 1;
+    }
+    uint8_t *hdr = frame - TIO_USB_DATA_IDX;
+    hdr[TIO_USB_DLEN_IDX] = length & 0xFF;
+    hdr[TIO_USB_DLEN_IDX + 1] = (length >> 8) & 0xFF;
+    // Single CRC pass over length and data already in place
+    return tio_usb_frame_commit_crc(frame, length, tio_crc16(hdr + TIO_USB_DLEN_IDX, length + TIO_USB_DLEN_LEN));
+}
+
+/**
+ * @brief Drop a reserved frame w/o sending
+ *
+ * @param frame DATA region returned by tio_usb_frame_reserve()
+ */
+void
+tio_usb_frame_cancel(uint8_t *frame)
+{
+    if (atomic_load(&tioTxResv) == TIO_USB_RESV_WRITING && frame == tioTxResvFrame + TIO_USB_DATA_IDX)
+    {
+        tio_usb_frame_release();
+    }
+}
+
+uint32_t
+tio_usb_tx_room(uint8_t slot_type, uint32_t frames)
+{
+    uint8_t lane = slot_type == 0 ? TIO_USB_TX_LANE_LO : TIO_USB_TX_LANE_HI;
+    // Other policies make room by evicting or waiting
+    if (tio_usb_tx_get_policy(slot_type).policy != TIO_USB_DROP_NEWEST)
+    {
+        return 0;
+    }
+    uint32_t room = 0;
+    tio_usb_tx_service();
+    if (tud_vendor_mounted())
+    {
+        AM_CRITICAL_BEGIN
+        room = ringbuffer_space(&tioTxLanes[lane]);
+        // Frames skip the lane while USB has room
+        if (tio_usb_tx_lanes_empty(lane))
+        {
+            room += tud_vendor_write_available() / TIO_USB_PACKET_LEN;
+        }
+        AM_CRITICAL_END
+    }
+    if (room >= frames)
+    {
+        return 0;
+    }
+    AM_CRITICAL_BEGIN
+    tioTxStats.lanes[lane].dropped += frames;
+    AM_CRITICAL_END
+    return 1;
+}
+
+/**
+ * @brief USB TX complete callback
+ */
+static void
+tio_usb_tx_complete_cb(ns_usb_transaction_t *transaction)
+{
+    (void)transaction;
+    tio_usb_tx_kick(TIO_USB_TX_KICK_DRAIN);
+}
+
+/**
+ * @brief USB service callback
+ */
+static void
+tio_usb_service_cb(uint8_t status)
+{
+    (void)status;
+    tio_usb_tx_kick(TIO_USB_TX_KICK_DRAIN);
+}
+
+uint32_t
+tio_usb_tx_service(void)
+{
+    return tio_usb_tx_kick(TIO_USB_TX_KICK_DRAIN);
+}
+
+uint32_t
+tio_usb_tx_post_ctrl(const uint8_t *frame, uint32_t frameLen)
+{
+    if (tio_usb_tx_enqueue(TIO_USB_TX_LANE_HI, frame, frameLen, false))
+    {
+        tio_usb_tx_count_drop(TIO_USB_TX_LANE_HI);
+        return 1;
+    }
+    tio_usb_tx_kick(TIO_USB_TX_KICK_DRAIN);
+    return 0;
+}
+
+void
+tio_usb_tx_init(ns_usb_config_t *config)
+{
+    tioTxStageLen = 0;
+    tioTxStageFrames = 0;
+    memset(tioTxStageLaneFrames, 0, sizeof(tioTxStageLaneFrames));
+    for (uint8_t lane = 0; lane < TIO_USB_TX_LANES; lane++)
+    {
+        ringbuffer_flush(&tioTxLanes[lane]);
+    }
+    memset(&tioTxStats, 0, sizeof(tioTxStats));
+    memset(tioTxLatency, 0, sizeof(tioTxLatency));
+    tioTxResvFrame = NULL;
+    atomic_store(&tioTxResvInStage, false);
+    atomic_store(&tioTxResv, TIO_USB_RESV_IDLE);
+    atomic_store(&tioTxKick, 0);
+    atomic_flag_clear(&tioTxLock);
+    config->tx_cb = tio_usb_tx_complete_cb;
+    config->service_cb = tio_usb_service_cb;
+}
+
+uint32_t
+tio_usb_tx_backlog(void)
+{
+    AM_CRITICAL_BEGIN
+    uint32_t depth = ringbuffer_len(&tioTxLanes[TIO_USB_TX_LANE_LO]);
+    AM_CRITICAL_END
+    return depth * 100 / TIO_USB_TXQ_LO_DEPTH;
+}
+
+/**
+ * @brief Check if USB is mounted and has space to send a packet
+ * @return uint32_t
+ */
+uint32_t
+tio_usb_tx_available()
+{
+    return tio_usb_tx_space(TIO_USB_PACKET_LEN);
+}
+
+/**
+ * @brief Send packet buffer over USB
+ *
+ * @param packet USB packet
+ * @param length Packet buffer length (only the frame itself is sent)
+ * @return uint32_t 0 if sent or queued, 1 if dropped
+ */
+uint32_t
+tio_usb_send_slot_packet(uint8_t *packet, uint32_t length)
+{
+    uint32_t frameLen = tio_usb_frame_len(packet);
+    if (frameLen == 0 || length < frameLen)
+    {
+        ns_lp_printf("Invalid packet length\n");
+        return 1;
+    }
+    return tio_usb_tx_submit(packet, frameLen);
+}
+
+/**
+ * @brief Send all queued and staged frames now (as far as USB has room)
+ *
+ * If another context holds TX, it does the flush before releasing it.
+ *
+ * @return uint32_t Number of frames sent by this call
+ */
+uint32_t
+tio_usb_flush(void)
+{
+    return tio_usb_tx_kick(TIO_USB_TX_KICK_FLUSH);
+}
+
+/**
+ * @brief Get TX queue counters
+ *
+ * @param stats Counters
+ */
+void
+tio_usb_get_tx_stats(tio_usb_tx_stats_t *stats)
+{
+    AM_CRITICAL_BEGIN
+    *stats = tioTxStats;
+    AM_CRITICAL_END
+}
+
+/**
+ * @brief Get a slot's pack to USB hand-off latency histogram
+ *
+ * @param slot Slot number
+ * @param latency Histogram
+ * @return uint32_t 0 on success, 1 if slot is invalid
+ */
+uint32_t
+tio_usb_get_latency(uint8_t slot, tio_usb_latency_t *latency)
+{
+    if (slot >= TIO_USB_SLOTS)
+    {
+        return 1;
+    }
+    AM_CRITICAL_BEGIN
+    *latency = tioTxLatency[slot];
+    AM_CRITICAL_END
+    return 0;
+}